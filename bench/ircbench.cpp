@@ -0,0 +1,910 @@
+// Load generator for ircserv. Opens many client connections from a single
+// poll() loop, registers them, joins them to a set of channels and then
+// drives PRIVMSG at a fixed rate, timing every copy from the moment it is
+// written to the moment a recipient reads it. The last line printed is a
+// key=value summary for scripts, and the exit status is non-zero when a
+// client fails to set up, a message is lost or a latency limit given with -L
+// is missed. With -P, one more client pastes a block of lines into the first
+// channel in a single write when measurement starts, and every copy of every
+// pasted line must arrive as well. With -S, the server process's CPU time
+// and wakeups over the measurement are read from /proc and reported too; -r 0
+// with -S measures what an idle server costs. ircbench -h lists the options.
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+
+typedef unsigned long long Micros;
+
+static Micros nowUs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<Micros>(ts.tv_sec) * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+// Log-linear histogram: exact below 64 us, then 32 buckets per power of two
+// (about 3% resolution), so any number of samples fits in a few KiB.
+class Histogram
+{
+private:
+	static const unsigned kDirect = 64;
+	static const unsigned kSubBuckets = 32;
+	static const unsigned kBuckets = kDirect + 58 * kSubBuckets;
+
+	std::vector<unsigned long> _counts;
+	unsigned long _total;
+	Micros _max;
+
+	static unsigned indexOf(Micros value)
+	{
+		if (value < kDirect)
+			return static_cast<unsigned>(value);
+		unsigned bit = 63 - __builtin_clzll(value);
+		unsigned shift = bit - 5;
+		return kDirect + (bit - 6) * kSubBuckets + static_cast<unsigned>(value >> shift) - kSubBuckets;
+	}
+
+	static Micros upperBound(unsigned index)
+	{
+		if (index < kDirect)
+			return index;
+		unsigned bit = (index - kDirect) / kSubBuckets + 6;
+		Micros mantissa = (index - kDirect) % kSubBuckets + kSubBuckets;
+		return ((mantissa + 1) << (bit - 5)) - 1;
+	}
+
+public:
+	Histogram() : _counts(kBuckets, 0), _total(0), _max(0)
+	{
+	}
+
+	void record(Micros value)
+	{
+		++_counts[indexOf(value)];
+		++_total;
+		if (value > _max)
+			_max = value;
+	}
+
+	Micros percentile(double fraction) const
+	{
+		if (_total == 0)
+			return 0;
+		unsigned long rank = static_cast<unsigned long>(fraction * _total + 0.999999);
+		if (rank == 0)
+			rank = 1;
+		unsigned long seen = 0;
+		for (unsigned i = 0; i < kBuckets; i++)
+		{
+			seen += _counts[i];
+			if (seen >= rank)
+				return upperBound(i) < _max ? upperBound(i) : _max;
+		}
+		return _max;
+	}
+
+	unsigned long count() const
+	{
+		return _total;
+	}
+
+	Micros max() const
+	{
+		return _max;
+	}
+};
+
+// CPU time and voluntary context switches of a process, from /proc. Each
+// time a blocked poll() or epoll_wait() returns counts as a voluntary
+// switch, so the switch count is the event loop's wakeup count.
+struct ProcessSample
+{
+	double cpuSeconds;
+	unsigned long wakeups;
+	bool valid;
+
+	ProcessSample() : cpuSeconds(0), wakeups(0), valid(false)
+	{
+	}
+};
+
+static bool readProcFile(long pid, const char* name, char* buffer, size_t size)
+{
+	char path[64];
+	std::snprintf(path, sizeof(path), "/proc/%ld/%s", pid, name);
+	FILE* file = std::fopen(path, "r");
+	if (!file)
+		return false;
+	size_t length = std::fread(buffer, 1, size - 1, file);
+	std::fclose(file);
+	buffer[length] = '\0';
+	return true;
+}
+
+static ProcessSample sampleProcess(long pid)
+{
+	ProcessSample sample;
+	char buffer[4096];
+	unsigned long utime;
+	unsigned long stime;
+
+	if (pid <= 0 || !readProcFile(pid, "stat", buffer, sizeof(buffer)))
+		return sample;
+	// utime and stime are fields 14 and 15; the command name before them
+	// is parenthesised and may contain spaces.
+	const char* fields = std::strrchr(buffer, ')');
+	if (!fields || std::sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+		&utime, &stime) != 2)
+		return sample;
+	sample.cpuSeconds = static_cast<double>(utime + stime) / sysconf(_SC_CLK_TCK);
+
+	if (!readProcFile(pid, "status", buffer, sizeof(buffer)))
+		return sample;
+	const char* line = std::strstr(buffer, "\nvoluntary_ctxt_switches:");
+	if (!line || std::sscanf(line, "\nvoluntary_ctxt_switches: %lu", &sample.wakeups) != 1)
+		return sample;
+	sample.valid = true;
+	return sample;
+}
+
+struct Options
+{
+	std::string host;
+	std::string port;
+	std::string password;
+	std::string nickPrefix;
+	size_t clients;
+	size_t channels;
+	size_t joins;
+	double rate;
+	double duration;
+	size_t size;
+	size_t flooders;
+	size_t pasteLines;
+	double setupTimeout;
+	Micros maxP99;
+	long serverPid;
+	bool quiet;
+
+	Options()
+		: host("127.0.0.1"), port("6667"), password(""), nickPrefix("b"), clients(100), channels(10),
+		  joins(1), rate(1000), duration(10), size(64), flooders(0), pasteLines(0), setupTimeout(60), maxP99(0), serverPid(0),
+		  quiet(false)
+	{
+	}
+};
+
+enum ConnState
+{
+	CONNECTING,
+	REGISTERING,
+	JOINING,
+	READY,
+	CLOSED
+};
+
+struct Conn
+{
+	int fd;
+	size_t id;
+	ConnState state;
+	bool flooder;
+	bool paster;
+	std::string input;
+	std::string output;
+	size_t outputOffset;
+	Micros connectStart;
+	size_t joinsPending;
+	std::vector<size_t> channels;
+	size_t nextChannel;
+
+	Conn() : fd(-1), id(0), state(CONNECTING), flooder(false), paster(false), outputOffset(0), connectStart(0),
+		joinsPending(0), nextChannel(0)
+	{
+	}
+};
+
+class Bench
+{
+private:
+	const Options& _opts;
+	std::vector<Conn> _conns;
+	std::vector<size_t> _members;
+	struct sockaddr_storage _addr;
+	socklen_t _addrLength;
+	std::vector<struct pollfd> _pollFds;
+	std::vector<size_t> _pollConns;
+	std::string _padding;
+
+	size_t _ready;
+	size_t _failed;
+	size_t _dropped;
+	size_t _floodersDropped;
+	size_t _errors;
+	size_t _nextSender;
+	unsigned long _sent;
+	unsigned long _expected;
+	unsigned long _delivered;
+	unsigned long _pasteExpected;
+	unsigned long _pasteDelivered;
+	Micros _pasteStart;
+	Micros _pasteEnd;
+	bool _measuring;
+	Histogram _setup;
+	Histogram _latency;
+	ProcessSample _serverStart;
+	ProcessSample _serverEnd;
+
+	Bench(const Bench&);
+	Bench& operator=(const Bench&);
+
+	bool resolve()
+	{
+		struct addrinfo hints;
+		struct addrinfo* result;
+		std::memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		int status = getaddrinfo(_opts.host.c_str(), _opts.port.c_str(), &hints, &result);
+		if (status != 0)
+		{
+			std::fprintf(stderr, "ircbench: %s: %s\n", _opts.host.c_str(), gai_strerror(status));
+			return false;
+		}
+		std::memcpy(&_addr, result->ai_addr, result->ai_addrlen);
+		_addrLength = result->ai_addrlen;
+		freeaddrinfo(result);
+		return true;
+	}
+
+	// Client i joins `joins` consecutive channels starting at i * joins, so
+	// every channel ends up with about the same number of members. Flooders
+	// and the paster all sit in the first channel.
+	void buildTopology()
+	{
+		size_t total = _opts.clients + _opts.flooders + (_opts.pasteLines > 0 ? 1 : 0);
+		size_t joins = _opts.joins < _opts.channels ? _opts.joins : _opts.channels;
+
+		_conns.resize(total);
+		_members.assign(_opts.channels, 0);
+		for (size_t i = 0; i < total; i++)
+		{
+			Conn& conn = _conns[i];
+			conn.id = i;
+			conn.paster = i >= _opts.clients + _opts.flooders;
+			conn.flooder = i >= _opts.clients && !conn.paster;
+			if (_opts.channels == 0)
+				continue;
+			bool extra = conn.flooder || conn.paster;
+			size_t count = extra ? 1 : joins;
+			for (size_t k = 0; k < count; k++)
+			{
+				size_t channel = extra ? 0 : (i * joins + k) % _opts.channels;
+				conn.channels.push_back(channel);
+				++_members[channel];
+			}
+		}
+	}
+
+	std::string nickOf(size_t id) const
+	{
+		char buffer[32];
+		std::snprintf(buffer, sizeof(buffer), "%s%lu", _opts.nickPrefix.c_str(), static_cast<unsigned long>(id));
+		return buffer;
+	}
+
+	static std::string channelName(size_t channel)
+	{
+		char buffer[32];
+		std::snprintf(buffer, sizeof(buffer), "#bench%lu", static_cast<unsigned long>(channel));
+		return buffer;
+	}
+
+	void startConnect(Conn& conn)
+	{
+		conn.connectStart = nowUs();
+		conn.fd = socket(_addr.ss_family, SOCK_STREAM, 0);
+		if (conn.fd < 0 || fcntl(conn.fd, F_SETFL, O_NONBLOCK) < 0)
+		{
+			std::fprintf(stderr, "ircbench: socket: %s\n", std::strerror(errno));
+			fail(conn);
+			return;
+		}
+		int one = 1;
+		setsockopt(conn.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		if (connect(conn.fd, reinterpret_cast<struct sockaddr*>(&_addr), _addrLength) < 0 && errno != EINPROGRESS)
+			fail(conn);
+	}
+
+	void fail(Conn& conn)
+	{
+		if (conn.state == CLOSED)
+			return;
+		if (conn.state == READY)
+		{
+			--_ready;
+			++_dropped;
+			if (conn.flooder)
+				++_floodersDropped;
+			for (size_t i = 0; i < conn.channels.size(); i++)
+				--_members[conn.channels[i]];
+		}
+		else
+			++_failed;
+		conn.state = CLOSED;
+		if (conn.fd >= 0)
+			close(conn.fd);
+		conn.fd = -1;
+	}
+
+	void queue(Conn& conn, const std::string& line)
+	{
+		conn.output.append(line);
+		conn.output.append("\r\n", 2);
+	}
+
+	void flush(Conn& conn)
+	{
+		while (conn.outputOffset < conn.output.size())
+		{
+			ssize_t written = send(conn.fd, conn.output.data() + conn.outputOffset,
+				conn.output.size() - conn.outputOffset, 0);
+			if (written < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				if (errno != EAGAIN && errno != EWOULDBLOCK)
+					fail(conn);
+				break;
+			}
+			conn.outputOffset += written;
+		}
+		if (conn.outputOffset == conn.output.size())
+		{
+			conn.output.clear();
+			conn.outputOffset = 0;
+		}
+	}
+
+	void becomeReady(Conn& conn)
+	{
+		conn.state = READY;
+		++_ready;
+	}
+
+	void onConnected(Conn& conn)
+	{
+		int error = 0;
+		socklen_t length = sizeof(error);
+		if (getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0)
+		{
+			fail(conn);
+			return;
+		}
+		conn.state = REGISTERING;
+		std::string nick = nickOf(conn.id);
+		if (!_opts.password.empty())
+			queue(conn, "PASS " + _opts.password);
+		queue(conn, "NICK " + nick);
+		queue(conn, "USER " + nick + " 0 * :ircbench");
+		flush(conn);
+	}
+
+	void onWelcome(Conn& conn)
+	{
+		_setup.record(nowUs() - conn.connectStart);
+		if (conn.channels.empty())
+		{
+			becomeReady(conn);
+			return;
+		}
+		std::string line = "JOIN ";
+		for (size_t i = 0; i < conn.channels.size(); i++)
+		{
+			if (i > 0)
+				line.append(1, ',');
+			line.append(channelName(conn.channels[i]));
+		}
+		conn.state = JOINING;
+		conn.joinsPending = conn.channels.size();
+		queue(conn, line);
+	}
+
+	void onJoined(Conn& conn)
+	{
+		if (conn.state == JOINING && conn.joinsPending > 0 && --conn.joinsPending == 0)
+			becomeReady(conn);
+	}
+
+	// Timed messages carry their send time: "b <micros> <padding>"; pasted
+	// lines are "p <sequence> <padding>".
+	void onPrivmsg(const char* text, const char* end)
+	{
+		if (end - text < 2 || text[1] != ' ')
+			return;
+		if (text[0] == 'p')
+		{
+			++_pasteDelivered;
+			_pasteEnd = nowUs();
+			return;
+		}
+		if (text[0] != 'b')
+			return;
+		Micros sentAt = 0;
+		for (text += 2; text < end && *text >= '0' && *text <= '9'; text++)
+			sentAt = sentAt * 10 + (*text - '0');
+		Micros now = nowUs();
+		++_delivered;
+		if (_measuring)
+			_latency.record(now > sentAt ? now - sentAt : 0);
+	}
+
+	// Works on the line in place: at a few hundred thousand deliveries a
+	// second, copying each one would show up in the latencies measured.
+	void handleLine(Conn& conn, const char* line, size_t length)
+	{
+		const char* end = line + length;
+
+		if (length > 5 && std::memcmp(line, "PING ", 5) == 0)
+		{
+			queue(conn, "PONG " + std::string(line + 5, end));
+			return;
+		}
+		if (length == 0 || line[0] != ':')
+			return;
+		const char* command = static_cast<const char*>(std::memchr(line, ' ', length));
+		if (!command)
+			return;
+		++command;
+		const char* commandEnd = static_cast<const char*>(std::memchr(command, ' ', end - command));
+		if (!commandEnd)
+			commandEnd = end;
+		size_t commandLength = commandEnd - command;
+
+		if (commandLength == 7 && std::memcmp(command, "PRIVMSG", 7) == 0)
+		{
+			for (const char* p = commandEnd; p + 1 < end; p++)
+			{
+				if (p[0] == ' ' && p[1] == ':')
+				{
+					onPrivmsg(p + 2, end);
+					break;
+				}
+			}
+		}
+		else if (commandLength != 3)
+			return;
+		else if (std::memcmp(command, "001", 3) == 0 && conn.state == REGISTERING)
+			onWelcome(conn);
+		else if (std::memcmp(command, "366", 3) == 0)
+			onJoined(conn);
+		else if (command[0] == '4' || command[0] == '5')
+		{
+			++_errors;
+			if (!_opts.quiet && _errors <= 10)
+				std::fprintf(stderr, "ircbench: %s: %.*s\n", nickOf(conn.id).c_str(), static_cast<int>(length), line);
+			if (conn.state == JOINING)
+				onJoined(conn);
+		}
+	}
+
+	void readInput(Conn& conn)
+	{
+		char buffer[65536];
+
+		while (conn.state != CLOSED)
+		{
+			ssize_t received = recv(conn.fd, buffer, sizeof(buffer), 0);
+			if (received < 0 && errno == EINTR)
+				continue;
+			if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+				break;
+			if (received <= 0)
+			{
+				fail(conn);
+				return;
+			}
+			conn.input.append(buffer, received);
+			if (static_cast<size_t>(received) < sizeof(buffer))
+				break;
+		}
+
+		const char* data = conn.input.data();
+		size_t start = 0;
+		size_t end;
+		while ((end = conn.input.find("\r\n", start)) != std::string::npos)
+		{
+			handleLine(conn, data + start, end - start);
+			start = end + 2;
+		}
+		conn.input.erase(0, start);
+		if (!conn.output.empty() && conn.state != CLOSED)
+			flush(conn);
+	}
+
+	// One poll() round over every live connection.
+	void pump(int timeoutMs)
+	{
+		_pollFds.clear();
+		_pollConns.clear();
+		for (size_t i = 0; i < _conns.size(); i++)
+		{
+			Conn& conn = _conns[i];
+			if (conn.state == CLOSED)
+				continue;
+			struct pollfd entry;
+			entry.fd = conn.fd;
+			entry.events = POLLIN;
+			if (conn.state == CONNECTING || !conn.output.empty())
+				entry.events |= POLLOUT;
+			entry.revents = 0;
+			_pollFds.push_back(entry);
+			_pollConns.push_back(i);
+		}
+		if (_pollFds.empty())
+		{
+			if (timeoutMs > 0)
+				usleep(timeoutMs * 1000);
+			return;
+		}
+		int count = poll(&_pollFds[0], _pollFds.size(), timeoutMs);
+		if (count <= 0)
+			return;
+		for (size_t i = 0; i < _pollFds.size(); i++)
+		{
+			short revents = _pollFds[i].revents;
+			if (!revents)
+				continue;
+			Conn& conn = _conns[_pollConns[i]];
+			if (conn.state == CONNECTING)
+			{
+				onConnected(conn);
+				continue;
+			}
+			if (revents & (POLLIN | POLLHUP | POLLERR))
+				readInput(conn);
+			if ((revents & POLLOUT) && conn.state != CLOSED)
+				flush(conn);
+		}
+	}
+
+	Conn* nextSender()
+	{
+		for (size_t tried = 0; tried < _opts.clients; tried++)
+		{
+			Conn& conn = _conns[_nextSender];
+			_nextSender = (_nextSender + 1) % _opts.clients;
+			if (conn.state == READY)
+				return &conn;
+		}
+		return NULL;
+	}
+
+	// Picks the sender's next channel, or with no channels the next
+	// client's nick, and stamps the line just before it is written.
+	bool sendTimed()
+	{
+		Conn* sender = nextSender();
+		if (!sender)
+			return false;
+
+		std::string target;
+		size_t recipients;
+		if (sender->channels.empty())
+		{
+			size_t peer = (sender->id + 1) % _opts.clients;
+			if (peer == sender->id || _conns[peer].state != READY)
+				return true;
+			target = nickOf(peer);
+			recipients = 1;
+		}
+		else
+		{
+			size_t channel = sender->channels[sender->nextChannel++ % sender->channels.size()];
+			target = channelName(channel);
+			recipients = _members[channel] - 1;
+		}
+
+		char stamp[32];
+		std::snprintf(stamp, sizeof(stamp), "%llu ", nowUs());
+		queue(*sender, "PRIVMSG " + target + " :b " + stamp + _padding);
+		flush(*sender);
+		++_sent;
+		_expected += recipients;
+		return true;
+	}
+
+	// Flooders write as fast as the socket drains, untimed; the server
+	// should cut them off while everyone else's latency stays flat.
+	void feedFlooders()
+	{
+		for (size_t i = _opts.clients; i < _conns.size(); i++)
+		{
+			Conn& conn = _conns[i];
+			if (!conn.flooder || conn.state != READY || conn.output.size() > 16384)
+				continue;
+			for (int k = 0; k < 64; k++)
+				queue(conn, "PRIVMSG #bench0 :f " + _padding);
+			flush(conn);
+		}
+	}
+
+	// The whole paste is queued at once and goes out in as few writes as
+	// the socket allows, the way a terminal delivers a clipboard.
+	void paste()
+	{
+		Conn& conn = _conns.back();
+		if (!conn.paster || conn.state != READY)
+			return;
+		for (size_t i = 0; i < _opts.pasteLines; i++)
+		{
+			char sequence[32];
+			std::snprintf(sequence, sizeof(sequence), "%lu ", static_cast<unsigned long>(i));
+			queue(conn, "PRIVMSG " + channelName(0) + " :p " + sequence + _padding);
+		}
+		_pasteExpected = _opts.pasteLines * (_members[0] - 1);
+		_pasteStart = nowUs();
+		flush(conn);
+	}
+
+	bool isDrained() const
+	{
+		return _delivered >= _expected && _pasteDelivered >= _pasteExpected;
+	}
+
+	void printResults(double setupSeconds, double sendSeconds, double drainSeconds)
+	{
+		unsigned long lost = _expected > _delivered ? _expected - _delivered : 0;
+		unsigned long pasteLost = _pasteExpected > _pasteDelivered ? _pasteExpected - _pasteDelivered : 0;
+		double pasteSeconds = _pasteEnd > _pasteStart ? (_pasteEnd - _pasteStart) / 1e6 : 0;
+		double serverCpu = 0;
+		double serverWakeups = 0;
+		if (_serverStart.valid && _serverEnd.valid && sendSeconds > 0)
+		{
+			serverCpu = (_serverEnd.cpuSeconds - _serverStart.cpuSeconds) / sendSeconds * 100;
+			serverWakeups = (_serverEnd.wakeups - _serverStart.wakeups) / sendSeconds;
+		}
+		double sendRate = sendSeconds > 0 ? _sent / sendSeconds : 0;
+		double deliveryRate = sendSeconds + drainSeconds > 0 ? _delivered / (sendSeconds + drainSeconds) : 0;
+
+		if (!_opts.quiet)
+		{
+			std::printf("setup:    %lu/%lu clients ready in %.3f s (connect to welcome p50 %llu us, p99 %llu us, max %llu us)\n",
+				static_cast<unsigned long>(_ready + _dropped), static_cast<unsigned long>(_conns.size()), setupSeconds,
+				_setup.percentile(0.50), _setup.percentile(0.99), _setup.max());
+			std::printf("sent:     %lu messages in %.3f s (%.1f/s), %lu deliveries expected\n",
+				_sent, sendSeconds, sendRate, _expected);
+			std::printf("received: %lu deliveries (%lu lost), %.1f/s\n", _delivered, lost, deliveryRate);
+			std::printf("latency:  p50 %llu us, p99 %llu us, p999 %llu us, max %llu us\n",
+				_latency.percentile(0.50), _latency.percentile(0.99), _latency.percentile(0.999), _latency.max());
+			if (_opts.flooders > 0)
+				std::printf("flooders: %lu of %lu disconnected\n",
+					static_cast<unsigned long>(_floodersDropped), static_cast<unsigned long>(_opts.flooders));
+			if (_serverStart.valid && _serverEnd.valid)
+				std::printf("server:   %.1f%% CPU, %.1f wakeups/s while measuring\n", serverCpu, serverWakeups);
+			if (_opts.pasteLines > 0)
+				std::printf("paste:    %lu lines, %lu of %lu copies delivered in %.3f s\n",
+					static_cast<unsigned long>(_opts.pasteLines), _pasteDelivered, _pasteExpected, pasteSeconds);
+			if (_errors > 0)
+				std::printf("errors:   %lu error replies\n", static_cast<unsigned long>(_errors));
+		}
+		std::printf("clients=%lu ready=%lu failed=%lu setup_s=%.3f setup_p99_us=%llu sent=%lu expected=%lu "
+			"delivered=%lu lost=%lu send_rate=%.1f delivery_rate=%.1f p50_us=%llu p99_us=%llu p999_us=%llu "
+			"max_us=%llu dropped=%lu flooders_dropped=%lu paste_delivered=%lu paste_lost=%lu paste_s=%.3f "
+			"server_cpu_pct=%.1f server_wakeups_s=%.1f errors=%lu\n",
+			static_cast<unsigned long>(_conns.size()), static_cast<unsigned long>(_ready + _dropped),
+			static_cast<unsigned long>(_failed), setupSeconds, _setup.percentile(0.99), _sent, _expected,
+			_delivered, lost, sendRate, deliveryRate, _latency.percentile(0.50), _latency.percentile(0.99),
+			_latency.percentile(0.999), _latency.max(), static_cast<unsigned long>(_dropped - _floodersDropped),
+			static_cast<unsigned long>(_floodersDropped), _pasteDelivered, pasteLost, pasteSeconds,
+			serverCpu, serverWakeups, static_cast<unsigned long>(_errors));
+	}
+
+public:
+	explicit Bench(const Options& opts)
+		: _opts(opts), _addrLength(0), _padding(opts.size, 'x'), _ready(0), _failed(0), _dropped(0),
+		  _floodersDropped(0), _errors(0), _nextSender(0), _sent(0), _expected(0), _delivered(0),
+		  _pasteExpected(0), _pasteDelivered(0), _pasteStart(0), _pasteEnd(0), _measuring(false)
+	{
+		std::memset(&_addr, 0, sizeof(_addr));
+	}
+
+	~Bench()
+	{
+		for (size_t i = 0; i < _conns.size(); i++)
+		{
+			if (_conns[i].fd >= 0)
+				close(_conns[i].fd);
+		}
+	}
+
+	int run()
+	{
+		if (!resolve())
+			return 2;
+		buildTopology();
+
+		// Setup: every connect is started at once, which is also what a
+		// reconnect storm after a server restart looks like.
+		Micros setupStart = nowUs();
+		Micros setupDeadline = setupStart + static_cast<Micros>(_opts.setupTimeout * 1e6);
+		for (size_t i = 0; i < _conns.size(); i++)
+			startConnect(_conns[i]);
+		while (_ready + _failed < _conns.size() && nowUs() < setupDeadline)
+			pump(10);
+		double setupSeconds = (nowUs() - setupStart) / 1e6;
+
+		// Measurement: messages are released on a fixed schedule, so a slow
+		// server shows up as latency rather than as a lower send rate. At
+		// rate 0 the clients just sit idle, answering PINGs.
+		_measuring = true;
+		_serverStart = sampleProcess(_opts.serverPid);
+		paste();
+		Micros sendStart = nowUs();
+		Micros sendEnd = sendStart + static_cast<Micros>(_opts.duration * 1e6);
+		Micros now = sendStart;
+		while (now < sendEnd)
+		{
+			unsigned long due = static_cast<unsigned long>((now - sendStart) * _opts.rate / 1e6);
+			for (size_t burst = 0; _sent < due && burst < 1000; burst++)
+			{
+				if (!sendTimed())
+					break;
+			}
+			feedFlooders();
+			pump(_sent < due ? 0 : _opts.rate > 0 ? 1 : 100);
+			now = nowUs();
+		}
+		_serverEnd = sampleProcess(_opts.serverPid);
+		double sendSeconds = (now - sendStart) / 1e6;
+
+		// Drain: wait for the stragglers, giving up after two quiet seconds.
+		Micros drainStart = nowUs();
+		Micros lastProgress = drainStart;
+		unsigned long lastDelivered = _delivered + _pasteDelivered;
+		while (!isDrained() && nowUs() - lastProgress < 2000000)
+		{
+			pump(10);
+			if (_delivered + _pasteDelivered != lastDelivered)
+			{
+				lastDelivered = _delivered + _pasteDelivered;
+				lastProgress = nowUs();
+			}
+		}
+		double drainSeconds = (nowUs() - drainStart) / 1e6;
+
+		printResults(setupSeconds, sendSeconds, drainSeconds);
+
+		int status = 0;
+		if (_failed > 0 || _dropped > _floodersDropped || !isDrained())
+			status = 1;
+		if (_opts.maxP99 > 0 && _latency.percentile(0.99) > _opts.maxP99)
+			status = 1;
+		return status;
+	}
+};
+
+static void usage()
+{
+	std::fprintf(stderr,
+		"usage: ircbench [options]\n"
+		"  -H host      server address (127.0.0.1)\n"
+		"  -p port      server port (6667)\n"
+		"  -w password  connection password\n"
+		"  -n prefix    nickname prefix; clients are <prefix>0, <prefix>1, ... (b)\n"
+		"  -c count     clients (100)\n"
+		"  -C count     channels; 0 sends private messages to the next client (10)\n"
+		"  -j count     channels each client joins (1)\n"
+		"  -r rate      timed PRIVMSGs per second, over all clients; 0 leaves them idle (1000)\n"
+		"  -d seconds   measurement time; 0 only times connection setup (10)\n"
+		"  -s bytes     message padding (64)\n"
+		"  -F count     extra clients flooding the first channel (0)\n"
+		"  -P lines     one extra client pastes this many lines into the first channel (0)\n"
+		"  -t seconds   time allowed for connection setup (60)\n"
+		"  -L micros    fail if p99 delivery latency exceeds this\n"
+		"  -S pid       report this process's CPU use and wakeups per second while measuring\n"
+		"  -q           print only the key=value summary\n");
+}
+
+static bool parseNumber(const char* text, double& value)
+{
+	char* end;
+	value = std::strtod(text, &end);
+	return *text && *end == '\0' && value >= 0;
+}
+
+static bool parseOptions(int argc, char** argv, Options& opts)
+{
+	int option;
+	double value;
+
+	while ((option = getopt(argc, argv, "H:p:w:n:c:C:j:r:d:s:F:P:t:L:S:qh")) != -1)
+	{
+		if (option == 'q')
+		{
+			opts.quiet = true;
+			continue;
+		}
+		if (option == '?' || option == 'h')
+			return false;
+		switch (option)
+		{
+			case 'H': opts.host = optarg; continue;
+			case 'p': opts.port = optarg; continue;
+			case 'w': opts.password = optarg; continue;
+			case 'n': opts.nickPrefix = optarg; continue;
+		}
+		if (!parseNumber(optarg, value))
+		{
+			std::fprintf(stderr, "ircbench: bad value for -%c: %s\n", option, optarg);
+			return false;
+		}
+		switch (option)
+		{
+			case 'c': opts.clients = static_cast<size_t>(value); break;
+			case 'C': opts.channels = static_cast<size_t>(value); break;
+			case 'j': opts.joins = static_cast<size_t>(value); break;
+			case 'r': opts.rate = value; break;
+			case 'd': opts.duration = value; break;
+			case 's': opts.size = static_cast<size_t>(value); break;
+			case 'F': opts.flooders = static_cast<size_t>(value); break;
+			case 'P': opts.pasteLines = static_cast<size_t>(value); break;
+			case 't': opts.setupTimeout = value; break;
+			case 'L': opts.maxP99 = static_cast<Micros>(value); break;
+			case 'S': opts.serverPid = static_cast<long>(value); break;
+		}
+	}
+	if (optind != argc || opts.clients == 0)
+		return false;
+	if ((opts.flooders > 0 || opts.pasteLines > 0) && opts.channels == 0)
+	{
+		std::fprintf(stderr, "ircbench: -F and -P need at least one channel\n");
+		return false;
+	}
+	return true;
+}
+
+// Every client is a descriptor; ask for as many as the hard limit allows.
+static void raiseDescriptorLimit(size_t wanted)
+{
+	struct rlimit limit;
+	if (getrlimit(RLIMIT_NOFILE, &limit) < 0)
+		return;
+	if (limit.rlim_cur < limit.rlim_max)
+	{
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+	if (limit.rlim_cur != RLIM_INFINITY && wanted > limit.rlim_cur)
+		std::fprintf(stderr, "ircbench: warning: %lu clients but only %lu descriptors allowed\n",
+			static_cast<unsigned long>(wanted), static_cast<unsigned long>(limit.rlim_cur));
+}
+
+int main(int argc, char** argv)
+{
+	Options opts;
+
+	if (!parseOptions(argc, argv, opts))
+	{
+		usage();
+		return 2;
+	}
+	signal(SIGPIPE, SIG_IGN);
+	raiseDescriptorLimit(opts.clients + opts.flooders + 17);
+	Bench bench(opts);
+	return bench.run();
+}
@@ -0,0 +1,723 @@
+// Microbenchmarks for the per-message hot paths: parsing, line framing,
+// reply formatting, target splitting, channel lookup and membership tests
+// (each next to the linear scan it replaced), disconnecting a client from
+// many channels, NAMES and channel fan-out, plus the timer wheel and
+// metrics recording. Everything runs in memory; queued output goes to
+// /dev/null. Each benchmark reports time and heap allocations per
+// operation, counted by the global operator new below (pool-backed objects
+// do not show up, which is the point of the pools), and, where it sends
+// output, writev() calls per line delivered. Run with `make bench`; a name
+// prefix as argument runs only the matching benchmarks.
+//
+// Two checks run before any numbers are printed, and the run fails if
+// either does: the timer wheel against a fake clock (no timer may fire
+// early or more than a tick late), and checkCommandAllocations (no command
+// may allocate more than its budget).
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <ctime>
+#include <map>
+#include <set>
+#include <new>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Parser.hpp"
+#include "LineBuffer.hpp"
+#include "Utils.hpp"
+#include "Channel.hpp"
+#include "Client.hpp"
+#include "TimerWheel.hpp"
+#include "Metrics.hpp"
+#include "Server.hpp"
+
+static unsigned long g_allocations = 0;
+static unsigned long g_allocatedBytes = 0;
+
+// Everything drain() flushes, across all benchmarks.
+static SendStats g_sendStats;
+
+// Kept out of line: once inlined, GCC pairs the free() below with the
+// caller's operator new and reports a mismatch.
+__attribute__((noinline)) void* operator new(size_t size) throw(std::bad_alloc)
+{
+	++g_allocations;
+	g_allocatedBytes += size;
+	void* memory = std::malloc(size ? size : 1);
+	if (!memory)
+		throw std::bad_alloc();
+	return memory;
+}
+
+__attribute__((noinline)) void operator delete(void* memory) throw()
+{
+	std::free(memory);
+}
+
+static double nowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// One benchmark: `run` performs operation i; `batch` operations are timed
+// together, and `between` (untimed) restores whatever a batch used up.
+struct Benchmark
+{
+	const char* name;
+	size_t batch;
+	void (*run)(size_t i);
+	void (*between)();
+};
+
+static const double kMinRunNs = 200e6;
+
+static void report(const Benchmark& bench)
+{
+	double elapsed = 0;
+	unsigned long ops = 0;
+	unsigned long allocations = 0;
+	unsigned long bytes = 0;
+	SendStats sendBefore = g_sendStats;
+
+	for (size_t i = 0; i < bench.batch; i++)
+		bench.run(i);
+	if (bench.between)
+		bench.between();
+	while (elapsed < kMinRunNs)
+	{
+		unsigned long allocationsBefore = g_allocations;
+		unsigned long bytesBefore = g_allocatedBytes;
+		double start = nowNs();
+		for (size_t i = 0; i < bench.batch; i++)
+			bench.run(i);
+		elapsed += nowNs() - start;
+		allocations += g_allocations - allocationsBefore;
+		bytes += g_allocatedBytes - bytesBefore;
+		ops += bench.batch;
+		if (bench.between)
+			bench.between();
+	}
+	std::printf("%-28s %12.1f %12.2f %12.1f", bench.name, elapsed / ops,
+		static_cast<double>(allocations) / ops, static_cast<double>(bytes) / ops);
+	unsigned long lines = g_sendStats.linesSent - sendBefore.linesSent;
+	if (lines > 0)
+		std::printf(" %12.3f", static_cast<double>(g_sendStats.writeCalls - sendBefore.writeCalls) / lines);
+	std::printf("\n");
+}
+
+// Keeps results alive so the compiler cannot drop the work.
+static volatile size_t g_sink = 0;
+
+// Corpora.
+
+static std::string g_shortLine;
+static std::string g_longTrailing;
+static std::string g_tenTargets;
+static std::string g_manyParams;
+static std::string g_targetList;
+
+static void buildCorpora()
+{
+	g_shortLine = "PRIVMSG #general :hello there";
+	g_longTrailing = ":alice!~alice@host PRIVMSG #general :" + std::string(400, 'x');
+	g_tenTargets = "PRIVMSG alice,bob,carol,dave,erin,frank,grace,heidi,ivan,judy :lunch?";
+	g_manyParams = "MODE #general +ooooovvvv alice bob carol dave erin frank grace heidi ivan judy kate :end";
+	g_targetList = "alice,bob,carol,dave,erin,frank,grace,heidi,ivan,judy";
+}
+
+static void parseShort(size_t)
+{
+	g_sink += Parser::parseMessage(g_shortLine.data(), g_shortLine.size()).getParamCount();
+}
+
+static void parseLongTrailing(size_t)
+{
+	g_sink += Parser::parseMessage(g_longTrailing.data(), g_longTrailing.size()).getTrailing().size();
+}
+
+static void parseTenTargets(size_t)
+{
+	g_sink += Parser::parseMessage(g_tenTargets.data(), g_tenTargets.size()).getParamCount();
+}
+
+static void parseManyParams(size_t)
+{
+	g_sink += Parser::parseMessage(g_manyParams.data(), g_manyParams.size()).getParamCount();
+}
+
+// Line framing: a 64 KiB read's worth of mixed lines, one line per op.
+
+static LineBuffer g_input(8192);
+static std::string g_stream;
+static size_t g_streamLines = 0;
+
+static void buildStream()
+{
+	const std::string* lines[] = { &g_shortLine, &g_longTrailing, &g_tenTargets, &g_manyParams };
+	while (g_stream.size() < 60 * 1024)
+	{
+		g_stream += *lines[g_streamLines % 4];
+		g_stream += "\r\n";
+		++g_streamLines;
+	}
+}
+
+static void refillInput()
+{
+	char* buffer = g_input.prepareWrite(g_stream.size());
+	std::memcpy(buffer, g_stream.data(), g_stream.size());
+	g_input.commitWrite(g_stream.size());
+}
+
+static void frameLine(size_t)
+{
+	const char* line;
+	size_t length;
+	if (g_input.nextLine(line, length))
+		g_sink += length;
+}
+
+static void splitOne(size_t)
+{
+	g_sink += Utils::splitByComma(StringView("#general")).size();
+}
+
+static void splitTen(size_t)
+{
+	g_sink += Utils::splitByComma(StringView(g_targetList)).size();
+}
+
+static void formatReply(size_t)
+{
+	g_sink += Utils::formatReply(RPL_TOPIC, "alice", "#general :Welcome to the general channel").size();
+}
+
+// Replies and broadcasts are queued on real Client objects with no server
+// attached; their output is drained to /dev/null between batches.
+
+static int g_devNull = -1;
+static std::vector<Client*> g_members;
+static Channel* g_channel = NULL;
+static Client* g_replyClient = NULL;
+static std::string g_broadcastLine;
+
+static const size_t kChannelMembers = 5000;
+
+static void drain(Client* client)
+{
+	client->flushSendQueue(g_sendStats);
+}
+
+static void buildChannel()
+{
+	g_devNull = open("/dev/null", O_WRONLY);
+	g_channel = new Channel("#general");
+	for (size_t i = 0; i < kChannelMembers; i++)
+	{
+		Client* client = new Client(g_devNull, NULL, "127.0.0.1", 0, 0);
+		client->setNickname("user" + Utils::intToString(static_cast<int>(i)));
+		client->setUsername("u");
+		g_channel->addMember(client);
+		g_members.push_back(client);
+	}
+	g_replyClient = g_members[0];
+	g_broadcastLine = ":alice!~alice@127.0.0.1 PRIVMSG #general :" + std::string(80, 'x');
+}
+
+static void drainMembers()
+{
+	for (size_t i = 0; i < g_members.size(); i++)
+		drain(g_members[i]);
+}
+
+static void drainReplyClient()
+{
+	drain(g_replyClient);
+}
+
+static void sendReply(size_t)
+{
+	g_replyClient->sendReply(RPL_TOPIC, g_replyClient->getNickname(), "#general",
+		":Welcome to the general channel");
+}
+
+static void memberList(size_t)
+{
+	g_sink += g_channel->getMemberList().size();
+}
+
+// broadcast-5k queues ten lines per member before each drain, as a busy
+// loop iteration would; broadcast-5k-each drains after every line, the
+// worst case for writev coalescing.
+static void broadcast(size_t)
+{
+	g_channel->broadcast(g_broadcastLine, g_members[0]);
+}
+
+// Channel lookup by name: the case-folded std::map index Server::getChannel
+// uses, against the vector of channels it used to walk with string
+// compares. Lookups use a differently-cased spelling of an existing name,
+// which the old scan could not even match; it is timed on the exact name.
+
+static const size_t kFewChannels = 10;
+static const size_t kManyChannels = 50000;
+
+struct ChannelRegistry
+{
+	std::map<std::string, Channel*, IrcLess> index;
+	std::vector<Channel*> list;
+	std::vector<std::string> names;
+	std::vector<std::string> upperNames;
+};
+
+static ChannelRegistry g_fewChannels;
+static ChannelRegistry g_manyChannels;
+
+static void buildRegistry(ChannelRegistry& registry, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		std::string name = "#chan" + Utils::intToString(static_cast<int>(i));
+		Channel* channel = new Channel(name);
+		registry.index[name] = channel;
+		registry.list.push_back(channel);
+		registry.names.push_back(name);
+		registry.upperNames.push_back("#CHAN" + Utils::intToString(static_cast<int>(i)));
+	}
+}
+
+static Channel* findIndexed(ChannelRegistry& registry, size_t i)
+{
+	const std::string& name = registry.upperNames[(i * 7919) % registry.upperNames.size()];
+	std::map<std::string, Channel*, IrcLess>::iterator it = registry.index.find(name);
+	return it == registry.index.end() ? NULL : it->second;
+}
+
+static Channel* findScanned(ChannelRegistry& registry, size_t i)
+{
+	const std::string& name = registry.names[(i * 7919) % registry.names.size()];
+	for (size_t k = 0; k < registry.list.size(); ++k)
+	{
+		if (registry.list[k]->getName() == name)
+			return registry.list[k];
+	}
+	return NULL;
+}
+
+static void lookupFewIndexed(size_t i)
+{
+	g_sink += reinterpret_cast<size_t>(findIndexed(g_fewChannels, i));
+}
+
+static void lookupFewScanned(size_t i)
+{
+	g_sink += reinterpret_cast<size_t>(findScanned(g_fewChannels, i));
+}
+
+static void lookupManyIndexed(size_t i)
+{
+	g_sink += reinterpret_cast<size_t>(findIndexed(g_manyChannels, i));
+}
+
+static void lookupManyScanned(size_t i)
+{
+	g_sink += reinterpret_cast<size_t>(findScanned(g_manyChannels, i));
+}
+
+// Membership tests: Channel::isMember (a std::map keyed by client) against
+// std::find over a member vector, as Channel did before the flags table.
+// Every other probe is a client that is not in the channel.
+
+static const size_t kFewMembers = 5;
+
+static Channel* g_smallChannel = NULL;
+static std::vector<Client*> g_smallMembers;
+static Client* g_outsider = NULL;
+
+static void buildSmallChannel()
+{
+	g_smallChannel = new Channel("#small");
+	for (size_t i = 0; i < kFewMembers; i++)
+	{
+		g_smallChannel->addMember(g_members[i]);
+		g_smallMembers.push_back(g_members[i]);
+	}
+	g_outsider = new Client(g_devNull, NULL, "127.0.0.1", 0, 0);
+}
+
+static Client* probe(const std::vector<Client*>& members, size_t i)
+{
+	return i % 2 ? g_outsider : members[(i * 7919) % members.size()];
+}
+
+static void memberFewMap(size_t i)
+{
+	g_sink += g_smallChannel->isMember(probe(g_smallMembers, i));
+}
+
+static void memberFewScan(size_t i)
+{
+	Client* client = probe(g_smallMembers, i);
+	g_sink += std::find(g_smallMembers.begin(), g_smallMembers.end(), client) != g_smallMembers.end();
+}
+
+static void memberManyMap(size_t i)
+{
+	g_sink += g_channel->isMember(probe(g_members, i));
+}
+
+static void memberManyScan(size_t i)
+{
+	Client* client = probe(g_members, i);
+	g_sink += std::find(g_members.begin(), g_members.end(), client) != g_members.end();
+}
+
+// Disconnect of a client in 50000 channels: Server::removeClient's walk
+// over the client's channel set, draining it in place, against the
+// copy-then-iterate loop it replaced. The client rejoins between runs.
+
+static Client* g_leaver = NULL;
+
+static void buildLeaver()
+{
+	g_leaver = new Client(g_devNull, NULL, "127.0.0.1", 0, 0);
+	g_leaver->setNickname("leaver");
+}
+
+static void rejoinLeaver()
+{
+	for (size_t i = 0; i < g_manyChannels.list.size(); i++)
+		g_manyChannels.list[i]->addMember(g_leaver);
+}
+
+static void leaveInPlace(size_t)
+{
+	while (!g_leaver->getChannels().empty())
+	{
+		Channel* channel = *g_leaver->getChannels().begin();
+		channel->removeMember(g_leaver);
+		g_sink += channel->isEmpty();
+	}
+}
+
+static void leaveCopy(size_t)
+{
+	std::set<Channel*> joined = g_leaver->getChannels();
+	for (std::set<Channel*>::iterator it = joined.begin(); it != joined.end(); ++it)
+	{
+		(*it)->removeMember(g_leaver);
+		g_sink += (*it)->isEmpty();
+	}
+}
+
+// Timer wheel, driven by a fake clock advanced by hand.
+
+static const unsigned long kTickMs = 100;
+static const size_t kIdleTimers = 1000000;
+
+static TimerWheel* g_wheel = NULL;
+static Timer* g_timers = NULL;
+static unsigned long g_fakeNow = 0;
+static std::vector<Timer*> g_expired;
+
+static void buildWheel()
+{
+	g_wheel = new TimerWheel(g_fakeNow, kTickMs);
+	g_timers = new Timer[kIdleTimers];
+	for (size_t i = 0; i < kIdleTimers; i++)
+		g_wheel->schedule(g_timers[i], 0, 3600 * 1000 + (i * 7919) % (3600 * 1000));
+}
+
+static void rescheduleTimer(size_t i)
+{
+	Timer& timer = g_timers[(i * 7919) % kIdleTimers];
+	g_wheel->schedule(timer, 0, 3600 * 1000 + (i * 104729) % (3600 * 1000));
+}
+
+// Expired timers are put straight back an hour out, so the wheel stays at
+// a million timers however long the run.
+static void idleTick(size_t)
+{
+	g_fakeNow += kTickMs;
+	g_expired.clear();
+	g_wheel->advance(g_fakeNow, g_expired);
+	for (size_t i = 0; i < g_expired.size(); i++)
+		g_wheel->schedule(*g_expired[i], 0, 3600 * 1000);
+	g_sink += g_wheel->getTimeout(g_fakeNow);
+}
+
+// Schedules timers at pseudo-random delays from a tick to beyond the
+// wheel's range, cancels some, then steps the fake clock by getTimeout()
+// and checks every expiry against its due time. Every seventh timer is due
+// between one and about two and a half times the wheel's reach of 2^24
+// ticks, so it has to wait out at least one turn of the outer level.
+static bool checkWheel()
+{
+	const unsigned long reachMs = (1UL << 24) * kTickMs;
+	const size_t count = 200000;
+	unsigned long now = 5000;
+	TimerWheel wheel(now, kTickMs);
+	Timer* pool = new Timer[count];
+	std::vector<unsigned long> due(count);
+	unsigned long seed = 12345;
+	size_t scheduled = 0;
+	size_t far = 0;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+		unsigned long delay = (seed >> 33) % (i % 4 == 0 ? 1000 : i % 4 == 1 ? 600000 : 200000000);
+		if (i % 7 == 0)
+			delay = reachMs + (seed >> 20) % (3 * reachMs / 2);
+		pool[i].setOwner(reinterpret_cast<void*>(i));
+		wheel.schedule(pool[i], 0, delay);
+		due[i] = now + delay;
+		++scheduled;
+	}
+	for (size_t i = 0; i < count; i += 5)
+	{
+		wheel.cancel(pool[i]);
+		--scheduled;
+	}
+	for (size_t i = 0; i < count; i += 7)
+	{
+		if (i % 5 != 0)
+			++far;
+	}
+
+	size_t fired = 0;
+	size_t farFired = 0;
+	size_t mistimed = 0;
+	std::vector<Timer*> expired;
+	while (wheel.size() > 0)
+	{
+		int timeout = wheel.getTimeout(now);
+		now += timeout > 0 ? timeout : 1;
+		expired.clear();
+		wheel.advance(now, expired);
+		for (size_t k = 0; k < expired.size(); k++)
+		{
+			size_t i = reinterpret_cast<size_t>(expired[k]->getOwner());
+			if (i % 5 == 0 || now < due[i] || now - due[i] > kTickMs)
+				++mistimed;
+			++fired;
+			if (i % 7 == 0)
+				++farFired;
+		}
+	}
+	delete[] pool;
+	bool ok = mistimed == 0 && fired == scheduled && farFired == far;
+	std::printf("timer wheel fake-clock check: %lu of %lu timers fired (%lu past the wheel's reach), "
+		"%lu early, late or cancelled: %s\n", static_cast<unsigned long>(fired),
+		static_cast<unsigned long>(scheduled), static_cast<unsigned long>(farFired),
+		static_cast<unsigned long>(mistimed), ok ? "ok" : "FAILED");
+	return ok;
+}
+
+// Allocations per command, counted across parse, dispatch and the
+// handler with the replies it queues, on a Server with no connected
+// sockets. Each line is run once to warm the pools and the send queues,
+// then counted over repeated runs with output drained in between. The
+// check fails if parsing allocates at all, or if a line's average,
+// rounded down, exceeds its budget: zero for rejections in dispatch and
+// for PING, and today's count for the handlers that still build strings.
+// Rounding down leaves out the send queue's deque taking a new block
+// every few dozen lines.
+
+struct CommandCheck
+{
+	const char* line;
+	bool registered;
+	unsigned long budget;
+};
+
+static const CommandCheck kCommandChecks[] = {
+	{ "PRIVMSG #bench :are we there yet", false, 0 },
+	{ "JOIN", true, 0 },
+	{ "PING :lag-check-1234567890", true, 0 },
+	{ "PRIVMSG #bench :are we there yet", true, 3 },
+	{ "PRIVMSG bob :are we there yet", true, 3 },
+	{ "JOIN #bench", true, 7 }
+};
+
+class CommandBench
+{
+private:
+	Server& _server;
+	Client* _alice;
+	Client* _bob;
+	Client* _carol;
+	Client* _stranger;
+
+	Client* addClient(const std::string& nick, bool registered)
+	{
+		Client* client = new Client(g_devNull, &_server, "127.0.0.1", 0, 0);
+		client->setNickname(nick);
+		client->setUsername(nick);
+		client->setRegistered(registered);
+		if (registered)
+			_server._nicknames[nick] = client;
+		return client;
+	}
+
+	void flushAll()
+	{
+		for (size_t i = 0; i < _server._pendingFlush.size(); i++)
+		{
+			_server._pendingFlush[i]->flushSendQueue(g_sendStats);
+			_server._pendingFlush[i]->setFlushScheduled(false);
+		}
+		_server._pendingFlush.clear();
+	}
+
+	// Parse and execute once; returns what it allocated.
+	unsigned long run(Client* client, const std::string& line, unsigned long& parsing)
+	{
+		unsigned long before = g_allocations;
+		Command cmd = Parser::parseMessage(line.data(), line.size());
+		parsing += g_allocations - before;
+		_server.executeCommand(client, cmd);
+		unsigned long allocations = g_allocations - before;
+		// Undo a JOIN so the next run joins again.
+		Channel* channel = _server.getChannel("#bench");
+		if (client == _carol && channel && channel->isMember(_carol))
+			channel->removeMember(_carol);
+		flushAll();
+		return allocations;
+	}
+
+public:
+	CommandBench(Server& server) : _server(server)
+	{
+		_alice = addClient("alice", true);
+		_bob = addClient("bob", true);
+		_carol = addClient("carol", true);
+		_stranger = addClient("stranger", false);
+		Channel* channel = _server.createChannel("#bench");
+		channel->addMember(_alice);
+		channel->addMember(_bob);
+	}
+
+	~CommandBench()
+	{
+		delete _alice;
+		delete _bob;
+		delete _carol;
+		delete _stranger;
+	}
+
+	bool check()
+	{
+		const unsigned long runs = 100;
+		bool ok = true;
+
+		for (size_t i = 0; i < sizeof(kCommandChecks) / sizeof(kCommandChecks[0]); i++)
+		{
+			const CommandCheck& check = kCommandChecks[i];
+			std::string line(check.line);
+			Client* client = !check.registered ? _stranger : line.compare(0, 4, "JOIN") == 0 ? _carol : _alice;
+			unsigned long parsing = 0;
+			unsigned long total = 0;
+
+			run(client, line, parsing);
+			parsing = 0;
+			for (unsigned long k = 0; k < runs; k++)
+				total += run(client, line, parsing);
+			bool passed = parsing == 0 && total / runs <= check.budget;
+			std::printf("allocations: %-40s %s  parse %.2f  total %.2f  budget %lu  %s\n", check.line,
+				check.registered ? "registered  " : "unregistered", static_cast<double>(parsing) / runs,
+				static_cast<double>(total) / runs, check.budget, passed ? "ok" : "FAILED");
+			ok = ok && passed;
+		}
+		return ok;
+	}
+};
+
+static bool checkCommandAllocations()
+{
+	ServerConfig config;
+	Server server(0, "bench", config);
+	CommandBench bench(server);
+	return bench.check();
+}
+
+// What executeCommand adds to every command: two clock reads and a
+// histogram update.
+
+static Metrics g_metrics(0);
+
+static void recordCommand(size_t i)
+{
+	struct timespec start;
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	g_metrics.recordCommand(static_cast<CommandId>(i % CMD_COUNT),
+		(end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec);
+}
+
+static const Benchmark kBenchmarks[] = {
+	{ "parse/short",               1000, parseShort, NULL },
+	{ "parse/long-trailing",       1000, parseLongTrailing, NULL },
+	{ "parse/privmsg-10-targets",  1000, parseTenTargets, NULL },
+	{ "parse/mode-15-params",      1000, parseManyParams, NULL },
+	{ "frame/line",                0, frameLine, refillInput },
+	{ "split/1-target",            1000, splitOne, NULL },
+	{ "split/10-targets",          1000, splitTen, NULL },
+	{ "reply/formatReply",         1000, formatReply, NULL },
+	{ "reply/sendReply",           1000, sendReply, drainReplyClient },
+	{ "lookup/10-indexed",         1000, lookupFewIndexed, NULL },
+	{ "lookup/10-scan",            1000, lookupFewScanned, NULL },
+	{ "lookup/50k-indexed",        1000, lookupManyIndexed, NULL },
+	{ "lookup/50k-scan",           10, lookupManyScanned, NULL },
+	{ "member/5-map",              1000, memberFewMap, NULL },
+	{ "member/5-scan",             1000, memberFewScan, NULL },
+	{ "member/5k-map",             1000, memberManyMap, NULL },
+	{ "member/5k-scan",            100, memberManyScan, NULL },
+	{ "disconnect/50k-channels",   1, leaveInPlace, rejoinLeaver },
+	{ "disconnect/50k-copy",       1, leaveCopy, rejoinLeaver },
+	{ "channel/names-5k",          10, memberList, NULL },
+	{ "channel/broadcast-5k",      10, broadcast, drainMembers },
+	{ "channel/broadcast-5k-each", 1, broadcast, drainMembers },
+	{ "timer/reschedule-1M",       1000, rescheduleTimer, NULL },
+	{ "timer/idle-tick-1M",        64, idleTick, NULL },
+	{ "metrics/record-command",    1000, recordCommand, NULL }
+};
+
+int main(int argc, char** argv)
+{
+	const char* filter = argc > 1 ? argv[1] : "";
+
+	buildCorpora();
+	buildStream();
+	buildChannel();
+	buildSmallChannel();
+	buildRegistry(g_fewChannels, kFewChannels);
+	buildRegistry(g_manyChannels, kManyChannels);
+	buildLeaver();
+	rejoinLeaver();
+	if (!checkWheel() || !checkCommandAllocations())
+		return 1;
+	buildWheel();
+
+	std::printf("%-28s %12s %12s %12s %12s\n", "benchmark", "ns/op", "allocs/op", "bytes/op", "writev/line");
+	for (size_t i = 0; i < sizeof(kBenchmarks) / sizeof(kBenchmarks[0]); i++)
+	{
+		Benchmark bench = kBenchmarks[i];
+		if (std::strncmp(bench.name, filter, std::strlen(filter)) != 0)
+			continue;
+		if (bench.run == frameLine)
+		{
+			bench.batch = g_streamLines;
+			refillInput();
+		}
+		report(bench);
+	}
+	return 0;
+}
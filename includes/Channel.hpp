@@ -2,33 +2,59 @@
 #define CHANNEL_HPP
 
 #include <string>
-#include <vector>
+#include <list>
+#include <map>
 
 class Client;
 
 class Channel
 {
+    public:
+        enum
+        {
+            MEMBER = 1 << 0,
+            OPERATOR = 1 << 1,
+            INVITED = 1 << 2,
+            VOICE = 1 << 3,
+            HALFOP = 1 << 4
+        };
+
     private:
+        // One entry per client the channel knows about (members and
+        // invitees). Members are also linked into `members` in join order,
+        // which is what NAMES and broadcasts walk.
+        struct Membership
+        {
+            unsigned int flags;
+            std::list<Client*>::iterator position;
+
+            Membership() : flags(0) {}
+        };
+
         std::string name;
         std::string topic;
         std::string key;
-        std::vector<Client*> members;
-        std::vector<Client*> operators;
-        std::vector<Client*> inviteList;
+        std::map<Client*, Membership> table;
+        std::list<Client*> members;
+        size_t memberCount;
         bool inviteOnly;
         bool topicRestricted;
         int userLimit;
     public:
         Channel(const std::string& name);
         ~Channel();
+
+        static void* operator new(size_t size);
+        static void operator delete(void* object);
         const std::string& getName() const;
         const std::string& getTopic() const;
         const std::string& getKey() const;
-        const std::vector<Client*>& getMembers() const;
+        const std::list<Client*>& getMembers() const;
         size_t getMemberCount() const;
         void addMember(Client* client);
         void removeMember(Client* client);
         bool isMember(Client* client) const;
+        unsigned int getFlags(Client* client) const;
         void addOperator(Client* client);
         void removeOperator(Client* client);
         bool isOperator(Client* client)const;
@@ -2,37 +2,137 @@
 #define CLIENT_HPP
 
 #include <string>
+#include <deque>
+#include <set>
+#include "Payload.hpp"
+#include "LineBuffer.hpp"
+#include "StringView.hpp"
+#include "TimerWheel.hpp"
+
+class Server;
+class Channel;
+struct iovec;
+
+// Totals for the write path; linesSent - writeCalls is the number of
+// syscalls saved by coalescing queued lines into one writev().
+struct SendStats
+{
+	unsigned long writeCalls;
+	unsigned long linesSent;
+	unsigned long bytesSent;
+
+	SendStats();
+};
 
 class Client
 {
 private:
 	int _fd;
+	Server* _server;
 	std::string _nickname;
 	std::string _username;
-	std::string _buffer;
+	std::string _hostname;
+	std::string _source;
+	LineBuffer _input;
+	std::set<Channel*> _channels;
 	bool _authenticated;
 	bool _registered; 
     bool _hasPassword; 
 
+	std::deque<Payload> _sendQueue;
+	size_t _sendOffset;
+	size_t _sendQueueSize;
+	size_t _maxSendQueue;
+	bool _flushScheduled;
+	bool _inputReady;
+	bool _writeArmed;
+	bool _sendInFlight;
+	bool _closing;
+	const char* _inputEndReason;
+	std::string _quitReason;
+	unsigned long _penaltyUntil;
+	bool _throttled;
+	bool _readPaused;
+	bool _recvQueueFull;
+	unsigned long _recvQueueFullSince;
+	Timer _timer;
+	unsigned long _lastActivity;
+	unsigned long _pingSentAt;
+
 	Client();
 
+	void refreshSource();
+
+	bool reserveSendQueue(size_t length);
+	void appendLine(const char* const* parts, const size_t* lengths, size_t count);
+
 public:
-	Client(int fd);
+	// Upper bound on queued lines gathered into a single write.
+	static const size_t kMaxIovecs = 64;
+
+	Client(int fd, Server* server, const std::string& hostname, size_t maxSendQueue, unsigned long nowMs);
 	~Client();
 
+	static void* operator new(size_t size);
+	static void operator delete(void* object);
+
 	int getFd() const;
-	std::string getNickname() const;
-	std::string getUsername() const;
-	std::string getBuffer() const;
+	const std::string& getNickname() const;
+	const std::string& getUsername() const;
+	const std::string& getHostname() const;
+	const std::string& getSource() const;
+	LineBuffer& getInput();
 	bool isAuthenticated() const;
 
 	void setNickname(const std::string& nickname);
 	void setUsername(const std::string& username);
-	void appendBuffer(const std::string& data);
-	void clearBuffer();
 	void setAuthenticated(bool auth);
 
+	const std::set<Channel*>& getChannels() const;
+	void addChannel(Channel* channel);
+	void removeChannel(Channel* channel);
+
 	void sendMessage(const std::string& message);
+	void sendPayload(const Payload& payload);
+	void sendReply(int code, const StringView& target, const StringView& message);
+	void sendReply(int code, const StringView& target, const StringView& param, const StringView& message);
+	void sendCommand(const StringView& source, const char* command, const StringView& target, const StringView& text);
+	bool flushSendQueue(SendStats& stats);
+	size_t gatherSendQueue(struct iovec* iov) const;
+	void consumeSendQueue(size_t sent, SendStats& stats);
+	bool hasPendingOutput() const;
+	size_t getSendQueueSize() const;
+
+	bool isFlushScheduled() const;
+	void setFlushScheduled(bool scheduled);
+	bool isInputReady() const;
+	void setInputReady(bool ready);
+	bool isWriteArmed() const;
+	void setWriteArmed(bool armed);
+	bool isSendInFlight() const;
+	void setSendInFlight(bool inFlight);
+	bool isClosing() const;
+	void markClosing(const std::string& reason);
+	const std::string& getQuitReason() const;
+	void endInput(const char* reason);
+	const char* getInputEndReason() const;
+
+	void addPenalty(unsigned long nowMs, unsigned long penaltyMs);
+	bool isOverPenalty(unsigned long nowMs, unsigned long windowMs) const;
+	unsigned long getPenaltyUntil() const;
+	bool isThrottled() const;
+	void setThrottled(bool throttled);
+	bool isReadPaused() const;
+	void setReadPaused(bool paused);
+	bool isRecvQueueFull() const;
+	void setRecvQueueFull(bool full, unsigned long nowMs);
+	unsigned long getRecvQueueFullSince() const;
+
+	Timer& getTimer();
+	void markActive(unsigned long nowMs);
+	unsigned long getLastActivity() const;
+	void markPingSent(unsigned long nowMs);
+	unsigned long getPingSentAt() const;
 
 	bool isRegistered() const;
     bool hasPassword() const;
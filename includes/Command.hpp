@@ -14,15 +14,54 @@
 #define COMMAND_HPP
 
 #include <string>
-#include <vector>
+#include "StringView.hpp"
 
+enum CommandId
+{
+    CMD_PASS,
+    CMD_NICK,
+    CMD_USER,
+    CMD_JOIN,
+    CMD_PRIVMSG,
+    CMD_NOTICE,
+    CMD_KICK,
+    CMD_MODE,
+    CMD_TOPIC,
+    CMD_INVITE,
+    CMD_PING,
+    CMD_PONG,
+    CMD_STATS,
+    CMD_COUNT
+};
+
+// Static description of a command token: the checks executeCommand applies
+// before dispatching, and the flood-control cost of running it, charged once
+// per comma-separated target in the first parameter when costPerTarget is set.
+struct CommandInfo
+{
+    const char* name;
+    CommandId id;
+    size_t minParams;
+    bool requiresRegistration;
+    unsigned int cost;
+    bool costPerTarget;
+};
+
+// A parsed line. Every field is a view into the framed input line, so the
+// line must stay untouched while the command is in use; parameters live in
+// a fixed inline array, so building and copying a Command never allocates.
 class Command
 {
+    public:
+        static const size_t MAX_PARAMS = 15;
+
     private:
-        std::string _prefix;
-        std::string _command;
-        std::vector<std::string> _params;
-        std::string _trailing;
+        const CommandInfo* _info;
+        StringView _prefix;
+        StringView _command;
+        StringView _params[MAX_PARAMS];
+        size_t _paramCount;
+        StringView _trailing;
         bool _valid;
 
     public:
@@ -31,19 +70,25 @@ class Command
         Command& operator=(const Command& rhs);
         ~Command();
 
-        const std::string& getPrefix() const;
-        const std::string& getCommand() const;
-        const std::vector<std::string>& getParams() const;
-        const std::string& getTrailing() const;
+        const CommandInfo* getInfo() const;
+        unsigned int getCost() const;
+        const StringView& getPrefix() const;
+        const StringView& getCommand() const;
+        size_t getParamCount() const;
+        const StringView& getParam(size_t index) const;
+        const StringView& getTrailing() const;
         bool isValid() const;
 
-        void setPrefix(const std::string& prefix);
-        void setCommand(const std::string& command);
-        void addParam(const std::string& param);
-        void setTrailing(const std::string& trailing);
+        void setInfo(const CommandInfo* info);
+        void setPrefix(const StringView& prefix);
+        void setCommand(const StringView& command);
+        bool addParam(const StringView& param);
+        void setTrailing(const StringView& trailing);
         void setValid(bool valid);
 
-        static bool isValidCommand(const std::string& cmd);
+        static const CommandInfo* lookup(const StringView& cmd);
+        static const CommandInfo* lookup(CommandId id);
+        static bool isValidCommand(const StringView& cmd);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,67 @@
+#ifndef CONFIG_HPP
+#define CONFIG_HPP
+
+#include <string>
+#include "Logger.hpp"
+
+// Runtime tunables. The command line is fixed to "./ircserv <port> <password>",
+// so everything else is read from the environment:
+//   IRCSERV_SERVER_NAME     name used as the source of server replies
+//   IRCSERV_REACTOR   event backend: "epoll" (default on Linux), "io_uring"
+//                     (accept, receive and send done by the ring on Linux 6.0+,
+//                     multishot poll on 5.13+, else falls back to epoll) or "poll"
+//   IRCSERV_MAX_SENDQ bytes queued for one client before it is dropped (0 = no limit)
+//   IRCSERV_LISTEN_BACKLOG  pending-connection queue length (the kernel caps it
+//                           at net.core.somaxconn)
+//   IRCSERV_ACCEPT_BUDGET   connections accepted per loop iteration (readiness
+//                           backends; the io_uring ring accepts on its own)
+//   IRCSERV_READ_BUDGET     bytes read from one client per loop iteration; with
+//                           io_uring receives, bytes buffered before its receive
+//                           is stopped until they have run
+//   IRCSERV_COMMAND_BUDGET  commands run for one client per loop iteration
+//   IRCSERV_FLOOD_PENALTY_MS  penalty per command cost unit (0 = no flood control)
+//   IRCSERV_FLOOD_WINDOW_MS   how far a client's penalty may run ahead before its
+//                             commands are deferred
+//   IRCSERV_MAX_RECVQ       deferred input buffered per client; beyond it the rest
+//                           is left unread in the socket
+//   IRCSERV_FLOOD_GRACE_MS  how long a deferred client may keep its recvq full
+//                           before it is dropped for excess flood
+//   IRCSERV_REGISTRATION_TIMEOUT_MS  time a connection has to register (0 = no limit)
+//   IRCSERV_PING_INTERVAL_MS  idle time before a client is sent a PING (0 = never)
+//   IRCSERV_PONG_TIMEOUT_MS   time a client has to answer that PING
+//   IRCSERV_METRICS_PORT    serve Prometheus metrics on 127.0.0.1:<port>/metrics
+//                           (0 = off, the default)
+//   IRCSERV_STATS_PUBLIC    1 to let every user see STATS t, h and z (disconnect
+//                           reasons, latencies, pool internals); by default
+//                           they are only on the metrics endpoint
+//   IRCSERV_LOG_LEVEL       debug, info (default), warn, error or off
+//   IRCSERV_LOG_CATEGORIES  comma-separated: server, client, command, channel,
+//                           message, parser (default all)
+//   IRCSERV_LOG_BODIES      1 to include message text in message records
+struct ServerConfig
+{
+	std::string serverName;
+	std::string reactor;
+	size_t maxSendQueue;
+	size_t listenBacklog;
+	size_t acceptBudget;
+	size_t readBudget;
+	size_t commandBudget;
+	size_t floodPenaltyMs;
+	size_t floodWindowMs;
+	size_t maxRecvQueue;
+	size_t floodGraceMs;
+	size_t registrationTimeoutMs;
+	size_t pingIntervalMs;
+	size_t pongTimeoutMs;
+	size_t metricsPort;
+	bool statsPublic;
+	LogLevel logLevel;
+	int logCategories;
+	bool logBodies;
+
+	ServerConfig();
+	void loadEnvironment();
+};
+
+#endif
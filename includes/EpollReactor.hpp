@@ -0,0 +1,35 @@
+#ifndef EPOLLREACTOR_HPP
+#define EPOLLREACTOR_HPP
+
+#include "Reactor.hpp"
+
+#ifdef __linux__
+
+#include <sys/epoll.h>
+
+class EpollReactor : public Reactor
+{
+private:
+	int _epollFd;
+	std::vector<struct epoll_event> _ready;
+
+	EpollReactor(const EpollReactor& other);
+	EpollReactor& operator=(const EpollReactor& other);
+
+	bool control(int op, int fd, int events);
+
+public:
+	EpollReactor();
+	~EpollReactor();
+
+	bool isOpen() const;
+	bool add(int fd, int events);
+	bool modify(int fd, int events);
+	void remove(int fd);
+	int wait(std::vector<Event>& events, int timeoutMs);
+	const char* getName() const;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef IOURINGREACTOR_HPP
+#define IOURINGREACTOR_HPP
+
+#include "Reactor.hpp"
+
+#ifdef __linux__
+
+#include <linux/io_uring.h>
+
+// Backend on io_uring, using raw syscalls. Every registered fd carries one
+// multishot request, and changes to them are queued as submissions and
+// sent to the kernel together with the wait in a single io_uring_enter()
+// call, instead of one epoll_ctl() per change.
+//
+// On 6.0+ it does the I/O itself (hasCompletions()): a multishot accept per
+// listening socket, a multishot recv per connection that picks its buffers
+// from a provided-buffer ring, and one send per connection at a time. Sends
+// are copied into memory the reactor owns, so the caller's queue may change
+// or go away while the kernel still has them. Elsewhere, and for fds added
+// with READ or WRITE, it only reports readiness, with a multishot POLL_ADD.
+// isOpen() is false when the kernel lacks io_uring or multishot poll (5.13+),
+// in which case Reactor::create falls back to epoll.
+//
+// A request that finds no free SQE, even after a flush, is never dropped:
+// add() and modify() fail with nothing changed, and the sends, removals
+// and re-arms they cannot fail back on are retried on the next wait().
+class IoUringReactor : public Reactor
+{
+private:
+	struct Ring
+	{
+		unsigned* head;
+		unsigned* tail;
+		unsigned mask;
+		unsigned entries;
+	};
+
+	// What an fd's request does; also the top byte of its user_data.
+	enum Op
+	{
+		OP_POLL,
+		OP_ACCEPT,
+		OP_RECEIVE,
+		OP_SEND
+	};
+
+	// generation changes when the fd is added or removed, sequence when
+	// its request is replaced: completions of a closed connection are
+	// dropped, while those of a replaced request can still carry bytes.
+	struct Slot
+	{
+		int events;
+		unsigned generation;
+		unsigned sequence;
+		Op op;
+		int send;
+		bool active;
+
+		Slot();
+	};
+
+	struct Send
+	{
+		int fd;
+		unsigned generation;
+		bool submitted;
+		std::vector<char> bytes;
+	};
+
+	int _ringFd;
+	void* _ringMemory;
+	size_t _ringSize;
+	struct io_uring_sqe* _sqes;
+	size_t _sqesSize;
+	Ring _sq;
+	unsigned* _sqFlags;
+	unsigned* _sqArray;
+	Ring _cq;
+	struct io_uring_cqe* _cqes;
+	std::vector<Slot> _slots;
+	std::vector<unsigned long long> _pendingRemoves;
+	std::vector<unsigned long long> _pendingArms;
+	std::vector<unsigned> _pendingSends;
+	bool _completions;
+	void* _bufferMemory;
+	size_t _bufferMemorySize;
+	// Indexed directly: in C++, the header's flexible-array member in
+	// io_uring_buf_ring lands 8 bytes past the tail it should overlay.
+	struct io_uring_buf* _bufferRing;
+	char* _buffers;
+	unsigned short _bufferTail;
+	std::vector<unsigned short> _usedBuffers;
+	std::vector<Send*> _sends;
+	std::vector<unsigned> _freeSends;
+
+	IoUringReactor(const IoUringReactor& other);
+	IoUringReactor& operator=(const IoUringReactor& other);
+
+	bool setup(unsigned entries);
+	bool setupCompletions();
+	struct io_uring_sqe* nextSqe();
+	bool reserve(unsigned count);
+	int enter(unsigned minComplete, int timeoutMs);
+	bool hasRequest(const Slot& slot) const;
+	unsigned long long currentRequest(int fd) const;
+	bool isLive(unsigned long long request) const;
+	bool isCurrent(unsigned long long request) const;
+	bool arm(int fd);
+	void rearm(unsigned long long request);
+	bool disarm(unsigned long long request);
+	bool submitSend(unsigned index);
+	void releaseSend(unsigned index);
+	void recycleBuffers();
+	void retryPending();
+	void completePoll(const struct io_uring_cqe& cqe, std::vector<Event>& events);
+	void completeAccept(const struct io_uring_cqe& cqe, std::vector<Event>& events);
+	void completeReceive(const struct io_uring_cqe& cqe, std::vector<Event>& events);
+	void completeSend(const struct io_uring_cqe& cqe, std::vector<Event>& events);
+
+public:
+	IoUringReactor();
+	~IoUringReactor();
+
+	bool isOpen() const;
+	bool add(int fd, int events);
+	bool modify(int fd, int events);
+	void remove(int fd);
+	int wait(std::vector<Event>& events, int timeoutMs);
+	const char* getName() const;
+
+	bool hasCompletions() const;
+	bool send(int fd, const struct iovec* iov, size_t count);
+};
+
+#endif
+
+#endif
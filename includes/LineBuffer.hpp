@@ -0,0 +1,42 @@
+#ifndef LINEBUFFER_HPP
+#define LINEBUFFER_HPP
+
+#include <cstddef>
+
+// Per-client input buffer. recv() writes straight into the free tail and
+// nextLine() hands out CRLF-terminated lines as views into the buffer,
+// resuming the CRLF search where the previous call stopped. Consumed bytes
+// are only reclaimed (by one memmove) when the tail runs out of room.
+// Storage comes from the buffer slab and is handed back whenever the buffer
+// drains, so idle clients hold no input memory.
+class LineBuffer
+{
+private:
+	char* _data;
+	size_t _capacity;
+	size_t _start;
+	size_t _end;
+	size_t _scan;
+	size_t _limit;
+
+	LineBuffer();
+	LineBuffer(const LineBuffer& other);
+	LineBuffer& operator=(const LineBuffer& other);
+
+	void reserve(size_t capacity);
+
+public:
+	explicit LineBuffer(size_t limit);
+	~LineBuffer();
+
+	char* prepareWrite(size_t wanted);
+	size_t writable() const;
+	void commitWrite(size_t count);
+
+	bool nextLine(const char*& line, size_t& length);
+	size_t pending() const;
+	bool isOverflowing() const;
+	void releaseIfEmpty();
+};
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef LOGGER_HPP
+#define LOGGER_HPP
+
+#include <string>
+#include "StringView.hpp"
+
+enum LogLevel
+{
+	LOG_DEBUG,
+	LOG_INFO,
+	LOG_WARN,
+	LOG_ERROR,
+	LOG_OFF
+};
+
+enum LogCategory
+{
+	LOG_SERVER = 1,
+	LOG_CLIENT = 2,
+	LOG_COMMAND = 4,
+	LOG_CHANNEL = 8,
+	LOG_MESSAGE = 16,
+	LOG_PARSER = 32,
+	LOG_ALL = 63
+};
+
+// Leveled, categorised logging that never blocks the event loop. Records
+// are formatted into a fixed-size ring and written out by flush(), which
+// the server calls once per loop iteration. flush() never blocks and
+// never changes the flags of the descriptor it was given, whose open file
+// description is shared with the shell or terminal: a tty or pipe is
+// reopened through /proc/self/fd as a private non-blocking description, a
+// socket is written with MSG_DONTWAIT, and a regular file is written as
+// is. A record that does not fit in the ring is dropped and counted; the
+// count is reported as soon as there is room again.
+//
+// The server is one thread with one wait per loop iteration (see "Scaling"
+// in the README), so the ring is drained from the loop itself rather than
+// by a background writer.
+class Logger
+{
+private:
+	static const size_t kRingSize = 64 * 1024;
+
+	static char _ring[kRingSize];
+	static size_t _head;
+	static size_t _tail;
+	static unsigned long _dropped;
+	static LogLevel _level;
+	static int _categories;
+	static bool _bodies;
+	static int _fd;
+	static int _ownFd;
+	static bool _isSocket;
+
+	static bool push(const char* data, size_t length);
+
+public:
+	static void open(int fd, LogLevel level, int categories, bool bodies);
+	static void close();
+
+	static bool isEnabled(LogLevel level, LogCategory category);
+	static bool logsBodies();
+	static bool hasPending();
+	static unsigned long getDropped();
+
+	static void commit(LogLevel level, LogCategory category, const char* text, size_t length);
+	static void flush();
+
+	static bool parseLevel(const std::string& name, LogLevel& level);
+	static bool parseCategories(const std::string& names, int& categories);
+};
+
+// Message text, only rendered (as ": text") when bodies are enabled.
+struct LogBody
+{
+	StringView text;
+
+	explicit LogBody(const StringView& body);
+};
+
+// One record under construction; committed to the ring when it goes out of
+// scope. Formats into an inline buffer, so building a record never
+// allocates. Use through LOG() so disabled records cost one test.
+class LogRecord
+{
+private:
+	static const size_t kMaxRecord = 480;
+
+	LogLevel _level;
+	LogCategory _category;
+	char _text[kMaxRecord];
+	size_t _length;
+
+	LogRecord(const LogRecord&);
+	LogRecord& operator=(const LogRecord&);
+
+	void append(const char* data, size_t length);
+	void appendUnsigned(unsigned long value);
+
+public:
+	LogRecord(LogLevel level, LogCategory category);
+	~LogRecord();
+
+	LogRecord& operator<<(const char* text);
+	LogRecord& operator<<(const std::string& text);
+	LogRecord& operator<<(const StringView& text);
+	LogRecord& operator<<(const LogBody& body);
+	LogRecord& operator<<(char c);
+	LogRecord& operator<<(int value);
+	LogRecord& operator<<(unsigned int value);
+	LogRecord& operator<<(long value);
+	LogRecord& operator<<(unsigned long value);
+};
+
+// A one-shot loop rather than if/else, so the macro is safe as the body of
+// an unbraced if.
+#define LOG(level, category) \
+	for (bool logOnce_ = Logger::isEnabled(level, category); logOnce_; logOnce_ = false) \
+		LogRecord(level, category)
+
+#endif
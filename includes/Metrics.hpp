@@ -0,0 +1,88 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <string>
+#include <map>
+#include <vector>
+#include "Command.hpp"
+#include "Pool.hpp"
+#include "Client.hpp"
+
+// Log-linear latency histogram in nanoseconds: four buckets per power of
+// two, so a percentile read back is within 25% of the true value. Buckets
+// include their upper bound, as Prometheus' le does, so every power of two
+// is an exact bucket edge for countAtMost(). Recording
+// is a bit scan and two increments; the whole histogram is a few KiB.
+class LatencyHistogram
+{
+private:
+	static const unsigned kSubBuckets = 4;
+	static const unsigned kBuckets = kSubBuckets + 62 * kSubBuckets;
+
+	unsigned long _counts[kBuckets];
+	unsigned long _count;
+	unsigned long long _sumNs;
+	unsigned long long _maxNs;
+
+	static unsigned indexOf(unsigned long long ns);
+	static unsigned long long upperBound(unsigned index);
+
+public:
+	LatencyHistogram();
+
+	void record(unsigned long long ns);
+	unsigned long getCount() const;
+	unsigned long long getSumNs() const;
+	unsigned long long getMaxNs() const;
+	unsigned long long percentileNs(double fraction) const;
+	unsigned long countAtMost(unsigned long long ns) const;
+};
+
+struct CommandMetrics
+{
+	unsigned long bytes;
+	LatencyHistogram latency;
+
+	CommandMetrics();
+};
+
+// Point-in-time values the server computes when metrics are read, rather
+// than keeping them up to date on every change.
+struct MetricsGauges
+{
+	size_t clients;
+	size_t registered;
+	size_t channels;
+	size_t throttled;
+	size_t timers;
+	size_t sendQueueBytes;
+	size_t maxSendQueueBytes;
+
+	MetricsGauges();
+};
+
+// Counters and per-command latency for the whole server. The server has a
+// single thread, so these are plain integers bumped in place; reading them
+// (STATS, the Prometheus endpoint) is the only thing that walks anything.
+struct Metrics
+{
+	unsigned long startedMs;
+	unsigned long connectionsAccepted;
+	unsigned long bytesReceived;
+	unsigned long linesReceived;
+	unsigned long unknownCommands;
+	unsigned long throttles;
+	SendStats send;
+	std::map<std::string, unsigned long> disconnects;
+	CommandMetrics commands[CMD_COUNT];
+
+	explicit Metrics(unsigned long nowMs);
+
+	void recordCommand(CommandId id, unsigned long long ns);
+	void recordDisconnect(const std::string& reason);
+
+	void renderPrometheus(std::string& out, unsigned long nowMs, const MetricsGauges& gauges,
+		const std::vector<PoolStats>& pools) const;
+};
+
+#endif
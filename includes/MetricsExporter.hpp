@@ -0,0 +1,65 @@
+#ifndef METRICSEXPORTER_HPP
+#define METRICSEXPORTER_HPP
+
+#include <string>
+#include <map>
+
+class Server;
+class Reactor;
+
+// Serves the metrics in Prometheus text format over HTTP on a port bound to
+// 127.0.0.1 only, using the server's own reactor: there is still exactly one
+// poll loop. Each connection gets one response to a GET /metrics and is then
+// closed. Requests are tiny, so a connection that sends more than a few KiB,
+// that would exceed the small connection limit, or that is still open
+// kConnectionTimeoutMs after it was accepted is simply dropped.
+//
+// The exporter never reads a clock; the server passes its loop time in.
+class MetricsExporter
+{
+private:
+	struct Connection
+	{
+		std::string request;
+		std::string response;
+		size_t sent;
+		unsigned long acceptedAt;
+
+		Connection();
+	};
+
+	static const size_t kMaxConnections = 16;
+	static const size_t kMaxRequest = 4096;
+	static const unsigned long kConnectionTimeoutMs = 5000;
+	static const unsigned long kAcceptRetryMs = 1000;
+
+	Server* _server;
+	Reactor* _reactor;
+	int _listenFd;
+	bool _acceptPaused;
+	unsigned long _acceptPausedAt;
+	std::map<int, Connection> _connections;
+
+	MetricsExporter();
+	MetricsExporter(const MetricsExporter& other);
+	MetricsExporter& operator=(const MetricsExporter& other);
+
+	void acceptConnections(unsigned long nowMs);
+	void pauseAccepting(unsigned long nowMs);
+	void resumeAccepting();
+	void readRequest(int fd, Connection& connection);
+	void buildResponse(Connection& connection);
+	void writeResponse(int fd, Connection& connection);
+	void closeConnection(int fd);
+
+public:
+	MetricsExporter(Server* server, Reactor* reactor, int port);
+	~MetricsExporter();
+
+	bool handles(int fd) const;
+	void handleEvent(int fd, int events, unsigned long nowMs);
+	void expire(unsigned long nowMs);
+	int getTimeout(unsigned long nowMs) const;
+};
+
+#endif
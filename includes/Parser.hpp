@@ -24,9 +24,8 @@ class Parser {
         Parser& operator=(const Parser& rhs);
         ~Parser();
     public:
-        static Command parseMessage(const std::string& raw);
+        static Command parseMessage(const char* raw, size_t length);
         static bool isComplete(const std::string& buffer);
-        static std::vector<std::string> extractMessages(std::string& buffer);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,49 @@
+#ifndef PAYLOAD_HPP
+#define PAYLOAD_HPP
+
+#include <string>
+
+class ObjectPool;
+
+// Immutable, reference-counted wire bytes for one outgoing line (CRLF
+// included). Copies share the same block, so a channel broadcast renders the
+// line once and every recipient's send queue holds a reference to it; the
+// block is freed when the last queue has flushed it.
+//
+// A block that only one queue holds may keep growing: replies rendered for a
+// single client are appended to the tail of its queue instead of each
+// getting a block of their own.
+class Payload
+{
+private:
+	struct Block
+	{
+		size_t refs;
+		size_t lines;
+		size_t size;
+		size_t capacity;
+		char* bytes;
+	};
+
+	Block* _block;
+
+	static ObjectPool& blockPool();
+	static Block* createBlock(size_t capacity);
+	void release();
+
+public:
+	Payload();
+	explicit Payload(const std::string& line);
+	Payload(const Payload& other);
+	Payload& operator=(const Payload& other);
+	~Payload();
+
+	const char* data() const;
+	size_t size() const;
+	size_t lineCount() const;
+	bool isExclusive() const;
+
+	void appendLine(const char* const* parts, const size_t* lengths, size_t count);
+};
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef POLLREACTOR_HPP
+#define POLLREACTOR_HPP
+
+#include "Reactor.hpp"
+#include <poll.h>
+
+class PollReactor : public Reactor
+{
+private:
+	std::vector<struct pollfd> _fds;
+	std::vector<int> _slots;
+
+	PollReactor(const PollReactor& other);
+	PollReactor& operator=(const PollReactor& other);
+
+public:
+	PollReactor();
+	~PollReactor();
+
+	bool add(int fd, int events);
+	bool modify(int fd, int events);
+	void remove(int fd);
+	int wait(std::vector<Event>& events, int timeoutMs);
+	const char* getName() const;
+};
+
+#endif
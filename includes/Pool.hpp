@@ -0,0 +1,83 @@
+#ifndef POOL_HPP
+#define POOL_HPP
+
+#include <cstddef>
+#include <vector>
+
+struct PoolStats
+{
+	const char* name;
+	size_t objectSize;
+	size_t inUse;
+	size_t free;
+	size_t highWater;
+	size_t chunks;
+	size_t bytesReserved;
+};
+
+// Fixed-size object allocator. Slots are carved out of page-aligned chunks
+// mapped straight from the OS, so connection and channel churn reuses the
+// same memory instead of fragmenting the heap, and trim() can hand chunks
+// that became entirely free back with munmap(). Every pool links itself
+// into a registry so statistics and trimming cover all of them.
+class ObjectPool
+{
+private:
+	struct Chunk
+	{
+		Chunk* next;
+		size_t used;
+		size_t bytes;
+		bool releasing;
+	};
+
+	struct FreeSlot
+	{
+		FreeSlot* next;
+	};
+
+	static ObjectPool* _registry;
+
+	const char* _name;
+	size_t _objectSize;
+	size_t _slotSize;
+	size_t _perChunk;
+	Chunk* _chunks;
+	FreeSlot* _free;
+	size_t _inUse;
+	size_t _freeCount;
+	size_t _highWater;
+	size_t _chunkCount;
+	ObjectPool* _nextPool;
+
+	ObjectPool();
+	ObjectPool(const ObjectPool& other);
+	ObjectPool& operator=(const ObjectPool& other);
+
+	bool grow();
+	static Chunk*& ownerOf(void* object);
+
+public:
+	ObjectPool(const char* name, size_t objectSize);
+	~ObjectPool();
+
+	void* allocate();
+	void release(void* object);
+	size_t trim();
+	PoolStats getStats() const;
+
+	static void collectStats(std::vector<PoolStats>& stats);
+	static size_t trimAll();
+};
+
+// Size-classed slab for byte buffers (input lines, outgoing payloads):
+// requests are rounded up to a power of two between 64 bytes and 16 KiB and
+// served from one ObjectPool per class. Larger requests go to the heap.
+class BufferPool
+{
+public:
+	static char* allocate(size_t wanted, size_t& capacity);
+	static void release(char* data, size_t capacity);
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef REACTOR_HPP
+#define REACTOR_HPP
+
+#include <string>
+#include <vector>
+#include <sys/uio.h>
+
+// Readiness notification backend used by Server::run. Backends report which
+// registered fds became readable/writable; handlers must drain a ready fd
+// until EAGAIN because edge-triggered backends will not report it again.
+//
+// A backend whose hasCompletions() is true can also do the I/O itself: a
+// listening fd added with ACCEPT has connections accepted for it, a
+// connection added with RECEIVE has its input received for it, and send()
+// writes bytes out. Each outcome comes back from wait() as an event of the
+// same name. Such an fd is never reported ready; modify(fd, 0) stops it
+// and modify() with the same interest starts it again.
+class Reactor
+{
+public:
+	enum
+	{
+		READ = 1,
+		WRITE = 2,
+		HANGUP = 4,
+		ACCEPT = 8,
+		RECEIVE = 16,
+		SEND = 32
+	};
+
+	// result is the accepted fd for ACCEPT, the byte count at data for
+	// RECEIVE (0 at end of stream) and the bytes written for SEND, or
+	// -errno. data stays valid until the next wait().
+	struct Event
+	{
+		int fd;
+		int events;
+		int result;
+		const char* data;
+	};
+
+	virtual ~Reactor();
+
+	virtual bool add(int fd, int events) = 0;
+	virtual bool modify(int fd, int events) = 0;
+	virtual void remove(int fd) = 0;
+	virtual int wait(std::vector<Event>& events, int timeoutMs) = 0;
+	virtual const char* getName() const = 0;
+
+	virtual bool hasCompletions() const;
+	virtual bool send(int fd, const struct iovec* iov, size_t count);
+
+	static Reactor* create(const std::string& backend);
+};
+
+#endif
@@ -3,30 +3,102 @@
 
 #include <string>
 #include <vector>
-#include <poll.h>
+#include <map>
+#include <csignal>
 #include "Client.hpp"
 #include "Command.hpp"
 #include "Channel.hpp"
+#include "Config.hpp"
+#include "Utils.hpp"
+#include "Reactor.hpp"
+#include "TimerWheel.hpp"
+#include "Metrics.hpp"
+
+class MetricsExporter;
+
+// What a client's timer (Client::getTimer) is currently waiting for.
+enum ClientTimerKind
+{
+	TIMER_REGISTRATION,
+	TIMER_PING,
+	TIMER_PONG,
+	TIMER_LINGER
+};
 
 class Server
 {
 private:
+	// bench/microbench.cpp runs commands through dispatch to count what
+	// each one allocates.
+	friend class CommandBench;
+
+	typedef void (Server::*CommandHandler)(Client* client, const Command& cmd);
+	typedef std::map<std::string, Channel*, IrcLess> ChannelIndex;
+	typedef std::map<std::string, Client*, IrcLess> NicknameIndex;
+
+	static const CommandHandler _handlers[CMD_COUNT];
+
 	int _serverFd;
 	int _port;
 	std::string _password;
 	std::vector<Client*> _clients;
-	std::vector<struct pollfd> _fds;
-	std::vector<Channel*> _channels;
+	size_t _clientCount;
+	bool _acceptPending;
+	bool _acceptStalled;
+	bool _acceptPaused;
+	unsigned long _acceptPausedAt;
+	ChannelIndex _channels;
+	NicknameIndex _nicknames;
+	Reactor* _reactor;
+	bool _completions;
+	std::vector<Client*> _pendingFlush;
+	std::vector<Client*> _closedClients;
+	std::vector<Client*> _readyClients;
+	std::vector<Client*> _throttledClients;
+	unsigned long _now;
+	TimerWheel _timers;
+	std::vector<Timer*> _expiredTimers;
+	ServerConfig _config;
+	Metrics _metrics;
+	MetricsExporter* _exporter;
+
+	static volatile sig_atomic_t _shutdownRequested;
 
 	Server();
 	Server(const Server& other);
 	Server& operator=(const Server& other);
 
-	void acceptNewClient();
-	void handleClientMessage(int index);
-	void removeClient(int index);
+	void acceptNewClients();
+	void acceptCompleted(int result);
+	void acceptFailed(int error);
+	void addClient(int clientFd, const struct sockaddr_in& clientAddr);
+	void pauseAccepting();
+	void resumeAccepting();
+	void handleClientMessage(Client* client);
+	void handleReceivedInput(Client* client);
+	void receiveInput(Client* client, const char* data, int result);
+	bool processInput(Client* client, size_t& commandBudget);
+	void markInputReady(Client* client);
+	void throttleClient(Client* client);
+	void holdInput(Client* client);
+	void releaseThrottledClients();
+	int getThrottleTimeout() const;
+	void chargeFanout(Client* client, size_t recipients);
+	void runTimers();
+	void handleClientTimer(Client* client, int kind);
+	void schedulePing(Client* client);
+	void disconnectClient(Client* client, const std::string& reason);
+	void removeClient(Client* client);
+	void reapClosedClients();
+	Client* getClientByFd(int fd);
+	void flushClient(Client* client);
+	void submitSend(Client* client);
+	void sendCompleted(Client* client, int result);
+	void updateInterest(Client* client);
+	void flushPendingOutput();
 	
 	void executeCommand(Client* client, const Command& cmd);
+	void dispatchCommand(Client* client, const Command& cmd);
 	void handlePass(Client* client, const Command& cmd);
 	void handleNick(Client* client, const Command& cmd);
 	void handleUser(Client* client, const Command& cmd);
@@ -36,21 +108,29 @@ private:
 	void handleChannelMessage(Client* client, const std::string& channelName, const std::string& message);
 	void handlePrivateMessage(Client* sender, const std::string& targetNick, const std::string& message);
 	void handleNotice(Client* client, const Command& cmd);
+	void handlePing(Client* client, const Command& cmd);
+	void handlePong(Client* client, const Command& cmd);
+	void handleStats(Client* client, const Command& cmd);
 	
 	bool isNicknameInUse(const std::string& nickname, Client* exclude);
+	void renameClient(Client* client, const std::string& nickname);
 	void sendWelcome(Client* client);
+	void collectGauges(MetricsGauges& gauges) const;
 
 public:
-	Server(int port, const std::string& password);
+	Server(int port, const std::string& password, const ServerConfig& config);
 	~Server();
 
 	void run();
+	static void requestShutdown();
 	std::string getPassword() const;
 	
 	Channel* createChannel(const std::string& name);
 	void removeChannel(const std::string& name);
 	Channel* getChannel(const std::string& name);
 	Client* getClientByNickname(const std::string& nickname);
+	void scheduleFlush(Client* client);
+	void renderMetrics(std::string& body);
 };
 
 #endif
\ No newline at end of file
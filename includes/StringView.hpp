@@ -0,0 +1,35 @@
+#ifndef STRINGVIEW_HPP
+#define STRINGVIEW_HPP
+
+#include <cstddef>
+#include <string>
+#include <ostream>
+
+// Non-owning (pointer, length) view. Parsed commands hand these out so a
+// line can be tokenised without copying it; the viewed bytes must outlive
+// the view.
+class StringView
+{
+private:
+	const char* _data;
+	size_t _size;
+
+public:
+	StringView();
+	StringView(const char* data, size_t size);
+	StringView(const char* str);
+	StringView(const std::string& str);
+
+	const char* data() const;
+	size_t size() const;
+	bool empty() const;
+	char operator[](size_t index) const;
+	std::string str() const;
+
+	bool operator==(const StringView& other) const;
+	bool operator!=(const StringView& other) const;
+};
+
+std::ostream& operator<<(std::ostream& os, const StringView& view);
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef TIMERWHEEL_HPP
+#define TIMERWHEEL_HPP
+
+#include <cstddef>
+#include <vector>
+
+// Intrusive timer node, embedded in whatever it times (e.g. a Client).
+// kind and owner tell the code handling an expiry what fired.
+class Timer
+{
+private:
+	friend class TimerWheel;
+
+	Timer* _prev;
+	Timer* _next;
+	unsigned long _expires;
+	unsigned _level;
+	unsigned _index;
+	int _kind;
+	void* _owner;
+
+	Timer(const Timer& other);
+	Timer& operator=(const Timer& other);
+
+public:
+	Timer();
+
+	void setOwner(void* owner);
+	void* getOwner() const;
+	int getKind() const;
+	bool isPending() const;
+};
+
+// Hierarchical timing wheel: four levels of 64 slots, each slot a level
+// further out covering 64 times the span of the one below. Scheduling and
+// cancelling are O(1) list operations; timers far out sit in an outer level
+// and cascade down as the wheel turns. Timers beyond the outer level's
+// reach (2^24 ticks, about 19 days at 100 ms) wait in its furthest slot
+// and are re-filed each time it comes round, so they never fire early.
+// Per-level occupancy bitmaps let getTimeout() find the next tick worth
+// waking for without touching the timers themselves, so the loop can sleep
+// in its poll call until then.
+//
+// The wheel never reads a clock; callers pass the current time in, which
+// makes it drivable by a fake clock.
+class TimerWheel
+{
+private:
+	static const unsigned kLevels = 4;
+	static const unsigned kSlotBits = 6;
+	static const unsigned kSlots = 1 << kSlotBits;
+
+	Timer _slots[kLevels][kSlots];
+	unsigned long long _occupied[kLevels];
+	unsigned long _start;
+	unsigned long _tickMs;
+	unsigned long _tick;
+	size_t _count;
+
+	TimerWheel();
+	TimerWheel(const TimerWheel& other);
+	TimerWheel& operator=(const TimerWheel& other);
+
+	void place(Timer& timer);
+	void unlink(Timer& timer);
+	void cascade(unsigned level);
+
+public:
+	TimerWheel(unsigned long nowMs, unsigned long tickMs);
+
+	void schedule(Timer& timer, int kind, unsigned long delayMs);
+	void cancel(Timer& timer);
+	void advance(unsigned long nowMs, std::vector<Timer*>& expired);
+	int getTimeout(unsigned long nowMs) const;
+	size_t size() const;
+};
+
+#endif
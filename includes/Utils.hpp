@@ -3,11 +3,16 @@
 
 #include <string>
 #include <vector>
+#include "StringView.hpp"
 
 #define RPL_WELCOME 001
 #define RPL_YOURHOST 002
 #define RPL_CREATED 003
 #define RPL_MYINFO 004
+#define RPL_STATSCOMMANDS 212
+#define RPL_ENDOFSTATS 219
+#define RPL_STATSUPTIME 242
+#define RPL_STATSDEBUG 249
 #define RPL_NOTOPIC 331
 #define RPL_TOPIC 332
 #define RPL_NAMREPLY 353
@@ -18,8 +23,10 @@
 #define ERR_CANNOTSENDTOCHAN 404
 #define ERR_TOOMANYCHANNELS 405
 #define ERR_TOOMANYTARGETS 407
+#define ERR_NOORIGIN 409
 #define ERR_NORECIPIENT 411
 #define ERR_NOTEXTTOSEND 412
+#define ERR_UNKNOWNCOMMAND 421
 #define ERR_NOTONCHANNEL 442
 #define ERR_NEEDMOREPARAMS 461
 #define ERR_ALREADYREGISTRED 462
@@ -32,16 +39,37 @@
 #define ERR_ERRONEUSNICKNAME 432
 #define ERR_NICKNAMEINUSE 433
 #define ERR_NOTREGISTERED 451
+#define ERR_NOPRIVILEGES 481
+
+// Orders names as their RFC 1459 case-folded forms would sort, folding
+// character by character, so the channel and nick indexes look names up
+// without building a folded copy.
+struct IrcLess
+{
+	bool operator()(const std::string& a, const std::string& b) const;
+};
 
 class Utils
 {
+private:
+	static std::string _serverName;
+	static std::string _replyPrefix;
+
 public:
+	static void setServerName(const std::string& name);
+	static const std::string& getServerName();
+	static const std::string& getReplyPrefix();
+	static const char* numericToken(int code);
+
 	static std::string formatReply(int code, const std::string& client, const std::string& message);
 	static std::string formatMessage(const std::string& prefix, const std::string& command, const std::string& params);
+	static std::string formatMessage(const std::string& source, const char* command,
+		const std::string& target, const std::string& text);
 	static std::string intToString(int num);
-	static std::vector<std::string> splitByComma(const std::string& str);
+	static std::vector<std::string> splitByComma(const StringView& str);
 	static bool isChannelName(const std::string& name);
 	static bool isValidChannelName(const std::string& name);
+	static char toIrcLower(char c);
 };
 
 #endif
\ No newline at end of file
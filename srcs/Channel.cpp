@@ -1,12 +1,20 @@
 #include "Channel.hpp"
 #include "Client.hpp"
-#include <algorithm>
+#include "Payload.hpp"
+#include "Pool.hpp"
 #include <sstream>
 
+static ObjectPool& channelPool()
+{
+    static ObjectPool pool("channel", sizeof(Channel));
+    return pool;
+}
+
 Channel::Channel(const std::string& name)
     : name(name), 
       topic(""),
       key(""),
+      memberCount(0),
       inviteOnly(false),
       topicRestricted(true),
       userLimit(0)
@@ -15,8 +23,18 @@ Channel::Channel(const std::string& name)
 Channel::~Channel()
 {
     members.clear();
-    operators.clear();
-    inviteList.clear();
+    table.clear();
+}
+
+void* Channel::operator new(size_t size)
+{
+    (void)size;
+    return channelPool().allocate();
+}
+
+void Channel::operator delete(void* object)
+{
+    channelPool().release(object);
 }
 
 const std::string& Channel::getName() const
@@ -34,7 +52,7 @@ const std::string& Channel::getKey() const
     return key;
 }
 
-const std::vector<Client*>& Channel::getMembers() const
+const std::list<Client*>& Channel::getMembers() const
 {
     return members;
 }
@@ -42,69 +60,98 @@ const std::vector<Client*>& Channel::getMembers() const
 
 size_t Channel::getMemberCount() const
 {
-    return members.size();
+    return memberCount;
 }
 
 void Channel::addMember(Client* client)
 {
-    if (!isMember(client))
+    Membership& entry = table[client];
+
+    if (entry.flags & MEMBER)
+        return;
+    entry.flags |= MEMBER;
+    entry.position = members.insert(members.end(), client);
+    ++memberCount;
+    client->addChannel(this);
+    if (memberCount == 1)
+        entry.flags |= OPERATOR;
+}
+
+void Channel::removeMember(Client* client)
+{
+    client->removeChannel(this);
+    std::map<Client*, Membership>::iterator it = table.find(client);
+    if (it == table.end())
+        return;
+    if (it->second.flags & MEMBER)
     {
-        members.push_back(client);
-        if (members.size() == 1)
-            addOperator(client);
+        members.erase(it->second.position);
+        --memberCount;
     }
+    table.erase(it);
 }
 
-void Channel::removeMember(Client* client)
+unsigned int Channel::getFlags(Client* client) const
 {
-    members.erase(std::remove(members.begin(), members.end(), client), members.end());
-    operators.erase(std::remove(operators.begin(), operators.end(), client), operators.end());
-    inviteList.erase(std::remove(inviteList.begin(), inviteList.end(), client), inviteList.end());
+    std::map<Client*, Membership>::const_iterator it = table.find(client);
+    if (it == table.end())
+        return 0;
+    return it->second.flags;
 }
 
 bool Channel::isMember(Client* client) const
 {
-    return std::find(members.begin(), members.end(), client) != members.end();
+    return getFlags(client) & MEMBER;
 }
 
 void Channel::addOperator(Client* client)
 {
-    if (isMember(client) && !isOperator(client))
-        operators.push_back(client);
+    std::map<Client*, Membership>::iterator it = table.find(client);
+    if (it != table.end() && (it->second.flags & MEMBER))
+        it->second.flags |= OPERATOR;
 }
 
 void Channel::removeOperator(Client* client)
 {
-    operators.erase(std::remove(operators.begin(), operators.end(), client), operators.end());
+    std::map<Client*, Membership>::iterator it = table.find(client);
+    if (it != table.end())
+        it->second.flags &= ~OPERATOR;
 }
 
 bool Channel::isOperator(Client* client) const
 {
-    return std::find(operators.begin(), operators.end(), client) != operators.end();
+    return getFlags(client) & OPERATOR;
 }
 
 void Channel::addInvite(Client* client)
 {
-    if (!isInvited(client))
-        inviteList.push_back(client);
+    Membership& entry = table[client];
+    entry.flags |= INVITED;
 }
 
 bool Channel::isInvited(Client* client) const
 {
-    return std::find(inviteList.begin(), inviteList.end(), client) != inviteList.end();
+    return getFlags(client) & INVITED;
 }
 
 void Channel::removeInvite(Client* client)
 {
-    inviteList.erase(std::remove(inviteList.begin(), inviteList.end(), client), inviteList.end());
+    std::map<Client*, Membership>::iterator it = table.find(client);
+    if (it == table.end())
+        return;
+    it->second.flags &= ~INVITED;
+    if (it->second.flags == 0)
+        table.erase(it);
 }
 
 void Channel::broadcast(const std::string& message, Client* sender)
 {
-    for (size_t i = 0; i < members.size(); ++i)
+    Payload payload(message);
+
+    for (std::list<Client*>::const_iterator it = members.begin(); it != members.end(); ++it)
     {
-        if (members[i] != sender)
-            members[i]->sendMessage(message);
+        if (*it != sender)
+            (*it)->sendPayload(payload);
     }
 }
 
@@ -164,7 +211,7 @@ bool Channel::isFull() const
 {
     if (userLimit <= 0)
         return false;
-    return static_cast<int>(members.size()) >= userLimit;
+    return static_cast<int>(memberCount) >= userLimit;
 }
 
 void Channel::setInviteOnly(bool invite)
@@ -179,22 +226,20 @@ bool Channel::isInviteOnly() const
 
 bool Channel::isEmpty() const
 {
-    return members.empty();
+    return memberCount == 0;
 }
 
 std::string Channel::getMemberList() const
 {
     std::string list;
-    
-    for (size_t i = 0; i < members.size(); ++i)
+
+    for (std::list<Client*>::const_iterator it = members.begin(); it != members.end(); ++it)
     {
-        if (isOperator(members[i]))
-            list += "@";
-        
-        list += members[i]->getNickname();
-        
-        if (i < members.size() - 1)
+        if (it != members.begin())
             list += " ";
+        if (table.find(*it)->second.flags & OPERATOR)
+            list += "@";
+        list += (*it)->getNickname();
     }
     return list;
 }
\ No newline at end of file
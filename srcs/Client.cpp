@@ -1,33 +1,87 @@
 #include "Client.hpp"
+#include "Server.hpp"
+#include "Utils.hpp"
+#include "Pool.hpp"
+#include <cerrno>
+#include <cstring>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
-Client::Client(int fd) : _fd(fd), _authenticated(false), _registered(false), _hasPassword(false)
+// Bytes a client may send without a CRLF before it is disconnected; well
+// above the 512-byte IRC line limit so slow links never trip it.
+static const size_t kMaxUnterminatedInput = 8192;
+
+// Replies keep being appended to the tail block of the send queue until it
+// reaches this size; then a new block is started.
+static const size_t kMaxCoalescedBlock = 4096;
+
+static ObjectPool& clientPool()
+{
+	static ObjectPool pool("client", sizeof(Client));
+	return pool;
+}
+
+SendStats::SendStats() : writeCalls(0), linesSent(0), bytesSent(0)
 {
 }
 
+Client::Client(int fd, Server* server, const std::string& hostname, size_t maxSendQueue, unsigned long nowMs)
+	: _fd(fd), _server(server), _hostname(hostname), _input(kMaxUnterminatedInput), _authenticated(false), _registered(false), _hasPassword(false),
+	  _sendOffset(0), _sendQueueSize(0), _maxSendQueue(maxSendQueue),
+	  _flushScheduled(false), _inputReady(false), _writeArmed(false), _sendInFlight(false), _closing(false),
+	  _inputEndReason(NULL),
+	  _penaltyUntil(0), _throttled(false), _readPaused(false), _recvQueueFull(false), _recvQueueFullSince(0),
+	  _lastActivity(nowMs), _pingSentAt(0)
+{
+	_timer.setOwner(this);
+	refreshSource();
+}
+
 Client::~Client()
 {
 }
 
+void* Client::operator new(size_t size)
+{
+	(void)size;
+	return clientPool().allocate();
+}
+
+void Client::operator delete(void* object)
+{
+	clientPool().release(object);
+}
+
 int Client::getFd() const
 {
 	return _fd;
 }
 
-std::string Client::getNickname() const
+const std::string& Client::getNickname() const
 {
 	return _nickname;
 }
 
-std::string Client::getUsername() const
+const std::string& Client::getUsername() const
 {
 	return _username;
 }
 
-std::string Client::getBuffer() const
+const std::string& Client::getHostname() const
+{
+	return _hostname;
+}
+
+// "nick!~user@host", the source of every line this client originates.
+const std::string& Client::getSource() const
+{
+	return _source;
+}
+
+LineBuffer& Client::getInput()
 {
-	return _buffer;
+	return _input;
 }
 
 bool Client::isAuthenticated() const
@@ -48,26 +102,46 @@ bool Client::hasPassword() const
 void Client::setNickname(const std::string& nickname)
 {
 	_nickname = nickname;
+	refreshSource();
 }
 
 void Client::setUsername(const std::string& username)
 {
 	_username = username;
+	refreshSource();
 }
 
-void Client::appendBuffer(const std::string& data)
+// Re-rendered only when NICK or USER changes, so relaying a line copies the
+// source instead of concatenating it again.
+void Client::refreshSource()
 {
-	_buffer += data;
+	_source.clear();
+	_source.reserve(_nickname.size() + _username.size() + _hostname.size() + 3);
+	_source.append(_nickname);
+	_source.append("!~", 2);
+	_source.append(_username);
+	_source.append(1, '@');
+	_source.append(_hostname);
 }
 
-void Client::clearBuffer()
+void Client::setAuthenticated(bool auth)
 {
-	_buffer.clear();
+	_authenticated = auth;
 }
 
-void Client::setAuthenticated(bool auth)
+const std::set<Channel*>& Client::getChannels() const
 {
-	_authenticated = auth;
+	return _channels;
+}
+
+void Client::addChannel(Channel* channel)
+{
+	_channels.insert(channel);
+}
+
+void Client::removeChannel(Channel* channel)
+{
+	_channels.erase(channel);
 }
 
 void Client::setRegistered(bool registered)
@@ -82,6 +156,324 @@ void Client::setHasPassword(bool hasPass)
 
 void Client::sendMessage(const std::string& message)
 {
-	std::string msg = message + "\r\n";
-	send(_fd, msg.c_str(), msg.length(), 0);
+	if (_closing)
+		return;
+	sendPayload(Payload(message));
+}
+
+// Queues the line; the server writes it out once the current loop
+// iteration is done.
+void Client::sendPayload(const Payload& payload)
+{
+	if (_closing)
+		return;
+
+	if (reserveSendQueue(payload.size()))
+		_sendQueue.push_back(payload);
+	if (_server)
+		_server->scheduleFlush(this);
+}
+
+// ":<server> <code> <target> <message>", rendered straight into the send
+// queue; message carries its own ':' where the reply needs one.
+void Client::sendReply(int code, const StringView& target, const StringView& message)
+{
+	const std::string& prefix = Utils::getReplyPrefix();
+	const char* parts[] = { prefix.data(), Utils::numericToken(code), target.data(), " ", message.data() };
+	size_t lengths[] = { prefix.size(), 4, target.size(), 1, message.size() };
+
+	appendLine(parts, lengths, 5);
+}
+
+// Same, with one parameter (usually the nick or channel the reply is
+// about) between the target and the message.
+void Client::sendReply(int code, const StringView& target, const StringView& param, const StringView& message)
+{
+	const std::string& prefix = Utils::getReplyPrefix();
+	const char* parts[] = { prefix.data(), Utils::numericToken(code), target.data(), " ",
+		param.data(), " ", message.data() };
+	size_t lengths[] = { prefix.size(), 4, target.size(), 1, param.size(), 1, message.size() };
+
+	appendLine(parts, lengths, 7);
+}
+
+// ":<source> <command> <target> :<text>", rendered the same way.
+void Client::sendCommand(const StringView& source, const char* command, const StringView& target, const StringView& text)
+{
+	const char* parts[] = { ":", source.data(), " ", command, " ", target.data(), " :", text.data() };
+	size_t lengths[] = { 1, source.size(), 1, std::strlen(command), 1, target.size(), 2, text.size() };
+
+	appendLine(parts, lengths, 8);
+}
+
+// Appends one line to the tail block when this client is its only holder
+// and it has room, so back-to-back replies share a single allocation.
+void Client::appendLine(const char* const* parts, const size_t* lengths, size_t count)
+{
+	if (_closing)
+		return;
+
+	size_t length = 2;
+	for (size_t i = 0; i < count; ++i)
+		length += lengths[i];
+	if (reserveSendQueue(length))
+	{
+		if (_sendQueue.empty() || !_sendQueue.back().isExclusive()
+			|| _sendQueue.back().size() + length > kMaxCoalescedBlock)
+			_sendQueue.push_back(Payload());
+		_sendQueue.back().appendLine(parts, lengths, count);
+	}
+	if (_server)
+		_server->scheduleFlush(this);
+}
+
+// Accounts for length more queued bytes. A client whose queue would grow
+// past the configured max-sendq is marked closing, its queue is dropped and
+// it is reaped at the end of the iteration.
+bool Client::reserveSendQueue(size_t length)
+{
+	if (_maxSendQueue > 0 && _sendQueueSize + length > _maxSendQueue)
+	{
+		markClosing("SendQ exceeded");
+		_sendQueue.clear();
+		_sendOffset = 0;
+		_sendQueueSize = 0;
+		return false;
+	}
+	_sendQueueSize += length;
+	return true;
+}
+
+// Writes as much of the queue as the socket accepts, gathering up to
+// kMaxIovecs queued lines per writev(). Returns false only on a hard socket
+// error; EAGAIN or a short write just leaves the rest queued.
+bool Client::flushSendQueue(SendStats& stats)
+{
+	struct iovec iov[kMaxIovecs];
+
+	while (!_sendQueue.empty())
+	{
+		size_t count = gatherSendQueue(iov);
+		size_t requested = 0;
+		for (size_t i = 0; i < count; ++i)
+			requested += iov[i].iov_len;
+
+		ssize_t sent = writev(_fd, iov, count);
+		if (sent < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+		}
+		consumeSendQueue(sent, stats);
+		if (static_cast<size_t>(sent) < requested)
+			break;
+	}
+	return true;
+}
+
+// Points iov (kMaxIovecs entries) at the unsent head of the queue and
+// returns how many entries it filled.
+size_t Client::gatherSendQueue(struct iovec* iov) const
+{
+	size_t count = 0;
+
+	for (std::deque<Payload>::const_iterator it = _sendQueue.begin();
+		it != _sendQueue.end() && count < kMaxIovecs; ++it, ++count)
+	{
+		iov[count].iov_base = const_cast<char*>(it->data());
+		iov[count].iov_len = it->size();
+	}
+	if (count > 0)
+	{
+		iov[0].iov_base = static_cast<char*>(iov[0].iov_base) + _sendOffset;
+		iov[0].iov_len -= _sendOffset;
+	}
+	return count;
+}
+
+// Drops the first sent bytes of the queue once they are written.
+void Client::consumeSendQueue(size_t sent, SendStats& stats)
+{
+	++stats.writeCalls;
+	stats.bytesSent += sent;
+	_sendQueueSize -= sent;
+
+	size_t consumed = _sendOffset + sent;
+	while (!_sendQueue.empty() && consumed >= _sendQueue.front().size())
+	{
+		consumed -= _sendQueue.front().size();
+		stats.linesSent += _sendQueue.front().lineCount();
+		_sendQueue.pop_front();
+	}
+	_sendOffset = consumed;
+}
+
+bool Client::hasPendingOutput() const
+{
+	return !_sendQueue.empty();
+}
+
+size_t Client::getSendQueueSize() const
+{
+	return _sendQueueSize;
+}
+
+bool Client::isFlushScheduled() const
+{
+	return _flushScheduled;
+}
+
+void Client::setFlushScheduled(bool scheduled)
+{
+	_flushScheduled = scheduled;
+}
+
+bool Client::isInputReady() const
+{
+	return _inputReady;
+}
+
+void Client::setInputReady(bool ready)
+{
+	_inputReady = ready;
+}
+
+bool Client::isWriteArmed() const
+{
+	return _writeArmed;
+}
+
+void Client::setWriteArmed(bool armed)
+{
+	_writeArmed = armed;
+}
+
+bool Client::isSendInFlight() const
+{
+	return _sendInFlight;
+}
+
+void Client::setSendInFlight(bool inFlight)
+{
+	_sendInFlight = inFlight;
+}
+
+bool Client::isClosing() const
+{
+	return _closing;
+}
+
+void Client::markClosing(const std::string& reason)
+{
+	if (_closing)
+		return;
+	_closing = true;
+	_quitReason = reason;
+}
+
+const std::string& Client::getQuitReason() const
+{
+	return _quitReason;
+}
+
+// Records that the peer closed the connection or it failed, once the
+// bytes received before that are buffered: the lines still run before the
+// client is disconnected for it.
+void Client::endInput(const char* reason)
+{
+	if (!_inputEndReason)
+		_inputEndReason = reason;
+}
+
+// NULL while input is still open.
+const char* Client::getInputEndReason() const
+{
+	return _inputEndReason;
+}
+
+// RFC 1459 style pacing: every command pushes the client's penalty clock
+// forward, and while that clock runs more than the flood window ahead of
+// real time its remaining input waits.
+void Client::addPenalty(unsigned long nowMs, unsigned long penaltyMs)
+{
+	if (_penaltyUntil < nowMs)
+		_penaltyUntil = nowMs;
+	_penaltyUntil += penaltyMs;
+}
+
+bool Client::isOverPenalty(unsigned long nowMs, unsigned long windowMs) const
+{
+	return _penaltyUntil > nowMs + windowMs;
+}
+
+unsigned long Client::getPenaltyUntil() const
+{
+	return _penaltyUntil;
+}
+
+bool Client::isThrottled() const
+{
+	return _throttled;
+}
+
+void Client::setThrottled(bool throttled)
+{
+	_throttled = throttled;
+}
+
+bool Client::isReadPaused() const
+{
+	return _readPaused;
+}
+
+void Client::setReadPaused(bool paused)
+{
+	_readPaused = paused;
+}
+
+// Tracks how long a deferred client has kept its recvq full: the time is
+// taken when it fills and kept until the client stops sending ahead.
+bool Client::isRecvQueueFull() const
+{
+	return _recvQueueFull;
+}
+
+void Client::setRecvQueueFull(bool full, unsigned long nowMs)
+{
+	if (full && !_recvQueueFull)
+		_recvQueueFullSince = nowMs;
+	_recvQueueFull = full;
+}
+
+unsigned long Client::getRecvQueueFullSince() const
+{
+	return _recvQueueFullSince;
+}
+
+// The one timer a client needs at a time: the registration deadline, then
+// alternately the idle PING probe and the wait for its answer.
+Timer& Client::getTimer()
+{
+	return _timer;
+}
+
+void Client::markActive(unsigned long nowMs)
+{
+	_lastActivity = nowMs;
+}
+
+unsigned long Client::getLastActivity() const
+{
+	return _lastActivity;
+}
+
+void Client::markPingSent(unsigned long nowMs)
+{
+	_pingSentAt = nowMs;
+}
+
+unsigned long Client::getPingSentAt() const
+{
+	return _pingSentAt;
 }
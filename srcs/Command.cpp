@@ -12,7 +12,24 @@
 
 #include "Command.hpp"
 
-Command::Command() : _prefix(""), _command(""), _trailing(""), _valid(true) {}
+// Indexed by CommandId.
+static const CommandInfo kCommands[CMD_COUNT] = {
+    { "PASS",    CMD_PASS,    1, false, 1, false },
+    { "NICK",    CMD_NICK,    0, false, 3, false },
+    { "USER",    CMD_USER,    3, false, 1, false },
+    { "JOIN",    CMD_JOIN,    1, true,  2, true  },
+    { "PRIVMSG", CMD_PRIVMSG, 0, true,  1, true  },
+    { "NOTICE",  CMD_NOTICE,  0, false, 1, true  },
+    { "KICK",    CMD_KICK,    2, true,  2, false },
+    { "MODE",    CMD_MODE,    1, true,  1, false },
+    { "TOPIC",   CMD_TOPIC,   1, true,  1, false },
+    { "INVITE",  CMD_INVITE,  2, true,  3, false },
+    { "PING",    CMD_PING,    0, false, 1, false },
+    { "PONG",    CMD_PONG,    0, false, 0, false },
+    { "STATS",   CMD_STATS,   0, true,  2, false }
+};
+
+Command::Command() : _info(NULL), _paramCount(0), _valid(true) {}
 
 Command::Command(const Command& src)
 {
@@ -23,9 +40,12 @@ Command& Command::operator=(const Command& other)
 {
     if (this != &other) 
     {
+        _info = other._info;
         _prefix = other._prefix;
         _command = other._command;
-        _params = other._params;
+        for (size_t i = 0; i < other._paramCount; i++)
+            _params[i] = other._params[i];
+        _paramCount = other._paramCount;
         _trailing = other._trailing;
         _valid = other._valid;
     }
@@ -34,22 +54,50 @@ Command& Command::operator=(const Command& other)
 
 Command::~Command() {}
 
-const std::string& Command::getPrefix() const
+// Flood-control penalty units for running this command.
+unsigned int Command::getCost() const
+{
+    if (!_info)
+        return 1;
+    if (!_info->costPerTarget || _paramCount == 0)
+        return _info->cost;
+
+    const StringView& targets = _params[0];
+    unsigned int count = 1;
+    for (size_t i = 0; i < targets.size(); ++i)
+    {
+        if (targets[i] == ',')
+            ++count;
+    }
+    return _info->cost * count;
+}
+
+const CommandInfo* Command::getInfo() const
+{
+    return _info;
+}
+
+const StringView& Command::getPrefix() const
 {
     return _prefix;
 }
 
-const std::string& Command::getCommand() const
+const StringView& Command::getCommand() const
 {
     return _command;
 }
 
-const std::vector<std::string>& Command::getParams() const
+size_t Command::getParamCount() const
+{
+    return _paramCount;
+}
+
+const StringView& Command::getParam(size_t index) const
 {
-    return _params;
+    return _params[index];
 }
 
-const std::string& Command::getTrailing() const
+const StringView& Command::getTrailing() const
 {
     return _trailing;
 }
@@ -59,22 +107,30 @@ bool Command::isValid() const
     return _valid;
 }
 
-void Command::setPrefix(const std::string& prefix)
+void Command::setInfo(const CommandInfo* info)
+{
+    _info = info;
+}
+
+void Command::setPrefix(const StringView& prefix)
 {
     _prefix = prefix;
 }
 
-void Command::setCommand(const std::string& command)
+void Command::setCommand(const StringView& command)
 {
     _command = command;
 }
 
-void Command::addParam(const std::string& param)
+bool Command::addParam(const StringView& param)
 {
-    _params.push_back(param);
+    if (_paramCount >= MAX_PARAMS)
+        return false;
+    _params[_paramCount++] = param;
+    return true;
 }
 
-void Command::setTrailing(const std::string& trailing)
+void Command::setTrailing(const StringView& trailing)
 {
     _trailing = trailing;
 }
@@ -84,15 +140,64 @@ void Command::setValid(bool valid)
     _valid = valid;
 }
 
-bool Command::isValidCommand(const std::string& cmd)
+// Picks the only possible candidate from the token length and first byte,
+// then confirms it with one comparison, so the cost does not grow with the
+// number of commands. Keep in sync with kCommands when adding one.
+const CommandInfo* Command::lookup(const StringView& cmd)
+{
+    const CommandInfo* candidate = NULL;
+
+    if (cmd.empty())
+        return NULL;
+    switch (cmd.size())
+    {
+        case 4:
+            switch (cmd[0])
+            {
+                case 'P':
+                    if (cmd[1] == 'A')
+                        candidate = &kCommands[CMD_PASS];
+                    else if (cmd[1] == 'I')
+                        candidate = &kCommands[CMD_PING];
+                    else if (cmd[1] == 'O')
+                        candidate = &kCommands[CMD_PONG];
+                    break;
+                case 'N': candidate = &kCommands[CMD_NICK]; break;
+                case 'U': candidate = &kCommands[CMD_USER]; break;
+                case 'J': candidate = &kCommands[CMD_JOIN]; break;
+                case 'K': candidate = &kCommands[CMD_KICK]; break;
+                case 'M': candidate = &kCommands[CMD_MODE]; break;
+            }
+            break;
+        case 5:
+            switch (cmd[0])
+            {
+                case 'T': candidate = &kCommands[CMD_TOPIC]; break;
+                case 'S': candidate = &kCommands[CMD_STATS]; break;
+            }
+            break;
+        case 6:
+            switch (cmd[0])
+            {
+                case 'N': candidate = &kCommands[CMD_NOTICE]; break;
+                case 'I': candidate = &kCommands[CMD_INVITE]; break;
+            }
+            break;
+        case 7:
+            candidate = &kCommands[CMD_PRIVMSG];
+            break;
+    }
+    if (candidate && cmd == candidate->name)
+        return candidate;
+    return NULL;
+}
+
+const CommandInfo* Command::lookup(CommandId id)
+{
+    return &kCommands[id];
+}
+
+bool Command::isValidCommand(const StringView& cmd)
 {
-	const std::string validCommands[] = {
-		"NICK", "USER", "PASS", "JOIN", "PRIVMSG", "NOTICE", "KICK", "MODE", "TOPIC", "INVITE"};
-	size_t count = sizeof(validCommands) / sizeof(validCommands[0]);
-	for (size_t i = 0; i < count; i++)
-	{
-		if (cmd == validCommands[i])
-			return true;
-	}
-	return false;
+    return lookup(cmd) != NULL;
 }
@@ -0,0 +1,70 @@
+#include "Config.hpp"
+#include <cstdlib>
+#include <climits>
+
+static size_t readSize(const char* name, size_t fallback)
+{
+	const char* value = std::getenv(name);
+	if (!value || !*value)
+		return fallback;
+
+	char* end;
+	unsigned long parsed = std::strtoul(value, &end, 10);
+	if (*end != '\0')
+		return fallback;
+	return parsed;
+}
+
+ServerConfig::ServerConfig()
+	: serverName("server"), reactor("epoll"), maxSendQueue(1024 * 1024),
+	  listenBacklog(4096), acceptBudget(256), readBudget(16 * 1024), commandBudget(64),
+	  floodPenaltyMs(100), floodWindowMs(10000), maxRecvQueue(64 * 1024),
+	  floodGraceMs(30000),
+	  registrationTimeoutMs(30000), pingIntervalMs(120000), pongTimeoutMs(60000),
+	  metricsPort(0), statsPublic(false),
+	  logLevel(LOG_INFO), logCategories(LOG_ALL), logBodies(false)
+{
+}
+
+void ServerConfig::loadEnvironment()
+{
+	const char* value = std::getenv("IRCSERV_SERVER_NAME");
+	if (value && *value)
+		serverName = value;
+	value = std::getenv("IRCSERV_REACTOR");
+	if (value && *value)
+		reactor = value;
+	maxSendQueue = readSize("IRCSERV_MAX_SENDQ", maxSendQueue);
+	listenBacklog = readSize("IRCSERV_LISTEN_BACKLOG", listenBacklog);
+	acceptBudget = readSize("IRCSERV_ACCEPT_BUDGET", acceptBudget);
+	readBudget = readSize("IRCSERV_READ_BUDGET", readBudget);
+	commandBudget = readSize("IRCSERV_COMMAND_BUDGET", commandBudget);
+	if (listenBacklog > INT_MAX)
+		listenBacklog = INT_MAX;
+	if (acceptBudget == 0)
+		acceptBudget = 1;
+	if (readBudget == 0)
+		readBudget = 1;
+	if (commandBudget == 0)
+		commandBudget = 1;
+	floodPenaltyMs = readSize("IRCSERV_FLOOD_PENALTY_MS", floodPenaltyMs);
+	floodWindowMs = readSize("IRCSERV_FLOOD_WINDOW_MS", floodWindowMs);
+	maxRecvQueue = readSize("IRCSERV_MAX_RECVQ", maxRecvQueue);
+	floodGraceMs = readSize("IRCSERV_FLOOD_GRACE_MS", floodGraceMs);
+	if (maxRecvQueue == 0)
+		maxRecvQueue = 1;
+	registrationTimeoutMs = readSize("IRCSERV_REGISTRATION_TIMEOUT_MS", registrationTimeoutMs);
+	pingIntervalMs = readSize("IRCSERV_PING_INTERVAL_MS", pingIntervalMs);
+	pongTimeoutMs = readSize("IRCSERV_PONG_TIMEOUT_MS", pongTimeoutMs);
+	metricsPort = readSize("IRCSERV_METRICS_PORT", metricsPort);
+	if (metricsPort > 65535)
+		metricsPort = 0;
+	statsPublic = readSize("IRCSERV_STATS_PUBLIC", statsPublic) != 0;
+	value = std::getenv("IRCSERV_LOG_LEVEL");
+	if (value && *value)
+		Logger::parseLevel(value, logLevel);
+	value = std::getenv("IRCSERV_LOG_CATEGORIES");
+	if (value && *value)
+		Logger::parseCategories(value, logCategories);
+	logBodies = readSize("IRCSERV_LOG_BODIES", logBodies) != 0;
+}
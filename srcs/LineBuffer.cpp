@@ -0,0 +1,109 @@
+#include "LineBuffer.hpp"
+#include "Pool.hpp"
+#include <cstring>
+
+LineBuffer::LineBuffer(size_t limit)
+	: _data(NULL), _capacity(0), _start(0), _end(0), _scan(0), _limit(limit)
+{
+}
+
+LineBuffer::~LineBuffer()
+{
+	BufferPool::release(_data, _capacity);
+}
+
+// Moves the buffered bytes into a larger slab buffer.
+void LineBuffer::reserve(size_t capacity)
+{
+	size_t granted;
+	char* data = BufferPool::allocate(capacity, granted);
+
+	if (_end > 0)
+		std::memcpy(data, _data, _end);
+	BufferPool::release(_data, _capacity);
+	_data = data;
+	_capacity = granted;
+}
+
+// Makes at least `wanted` bytes writable at the tail and returns a pointer
+// to them. Any line view handed out earlier is invalidated.
+char* LineBuffer::prepareWrite(size_t wanted)
+{
+	if (_start == _end)
+	{
+		_start = 0;
+		_end = 0;
+		_scan = 0;
+	}
+	else if (_capacity - _end < wanted && _start > 0)
+	{
+		std::memmove(_data, _data + _start, _end - _start);
+		_end -= _start;
+		_scan -= _start;
+		_start = 0;
+	}
+	if (_capacity - _end < wanted)
+		reserve(_end + wanted);
+	return _data + _end;
+}
+
+size_t LineBuffer::writable() const
+{
+	return _capacity - _end;
+}
+
+void LineBuffer::commitWrite(size_t count)
+{
+	_end += count;
+}
+
+// Yields the next complete line, CRLF included. Empty lines are skipped and
+// a bare LF does not end a line, matching what the parser accepts.
+bool LineBuffer::nextLine(const char*& line, size_t& length)
+{
+	while (_scan < _end)
+	{
+		const char* base = _data;
+		const void* found = std::memchr(base + _scan, '\n', _end - _scan);
+		if (!found)
+		{
+			_scan = _end;
+			return false;
+		}
+
+		size_t pos = static_cast<const char*>(found) - base;
+		_scan = pos + 1;
+		if (pos == _start || base[pos - 1] != '\r')
+			continue;
+
+		line = base + _start;
+		length = _scan - _start;
+		_start = _scan;
+		if (length > 2)
+			return true;
+	}
+	return false;
+}
+
+size_t LineBuffer::pending() const
+{
+	return _end - _start;
+}
+
+// True once a client has sent more than `limit` bytes without a line end.
+bool LineBuffer::isOverflowing() const
+{
+	return _end - _start > _limit;
+}
+
+void LineBuffer::releaseIfEmpty()
+{
+	if (_start != _end || !_data)
+		return;
+	BufferPool::release(_data, _capacity);
+	_data = NULL;
+	_capacity = 0;
+	_start = 0;
+	_end = 0;
+	_scan = 0;
+}
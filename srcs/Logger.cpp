@@ -0,0 +1,320 @@
+#include "Logger.hpp"
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+
+static const char* const kLevelNames[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+
+// Indexed by the bit position of the LogCategory.
+static const char* const kCategoryNames[] = { "server", "client", "command", "channel", "message", "parser" };
+static const size_t kCategoryCount = sizeof(kCategoryNames) / sizeof(kCategoryNames[0]);
+
+char Logger::_ring[Logger::kRingSize];
+size_t Logger::_head = 0;
+size_t Logger::_tail = 0;
+unsigned long Logger::_dropped = 0;
+LogLevel Logger::_level = LOG_INFO;
+int Logger::_categories = LOG_ALL;
+bool Logger::_bodies = false;
+int Logger::_fd = 2;
+int Logger::_ownFd = -1;
+bool Logger::_isSocket = false;
+
+static const char* categoryName(LogCategory category)
+{
+	for (size_t i = 0; i < kCategoryCount; ++i)
+	{
+		if (category == (1 << i))
+			return kCategoryNames[i];
+	}
+	return "log";
+}
+
+void Logger::open(int fd, LogLevel level, int categories, bool bodies)
+{
+	_fd = fd;
+	_level = level;
+	_categories = categories;
+	_bodies = bodies;
+	_ownFd = -1;
+	_isSocket = false;
+
+	struct stat st;
+	if (fstat(fd, &st) < 0 || S_ISREG(st.st_mode))
+		return;
+	if (S_ISSOCK(st.st_mode))
+	{
+		_isSocket = true;
+		return;
+	}
+	// Opening the /proc link gives a new open file description of the same
+	// tty or pipe, so O_NONBLOCK stays ours; setting it on fd (or a dup)
+	// would leave the user's terminal non-blocking if we crash.
+	char path[32];
+	std::snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+	_ownFd = ::open(path, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+}
+
+// Writes out whatever is still buffered, blocking if it has to, through
+// the descriptor the logger was given.
+void Logger::close()
+{
+	if (_ownFd >= 0)
+		::close(_ownFd);
+	_ownFd = -1;
+	_isSocket = false;
+	flush();
+}
+
+bool Logger::isEnabled(LogLevel level, LogCategory category)
+{
+	return level >= _level && (_categories & category);
+}
+
+bool Logger::logsBodies()
+{
+	return _bodies;
+}
+
+bool Logger::hasPending()
+{
+	return _head != _tail || _dropped > 0;
+}
+
+unsigned long Logger::getDropped()
+{
+	return _dropped;
+}
+
+bool Logger::push(const char* data, size_t length)
+{
+	if (length > kRingSize - (_head - _tail))
+		return false;
+
+	size_t offset = _head % kRingSize;
+	size_t first = kRingSize - offset;
+	if (first > length)
+		first = length;
+	std::memcpy(_ring + offset, data, first);
+	std::memcpy(_ring, data + first, length - first);
+	_head += length;
+	return true;
+}
+
+void Logger::commit(LogLevel level, LogCategory category, const char* text, size_t length)
+{
+	const char* levelName = kLevelNames[level < LOG_OFF ? level : LOG_ERROR];
+	const char* name = categoryName(category);
+	char header[32];
+	size_t headerLength = 0;
+
+	header[headerLength++] = '[';
+	for (const char* p = levelName; *p; ++p)
+		header[headerLength++] = *p;
+	header[headerLength++] = ']';
+	header[headerLength++] = ' ';
+	for (const char* p = name; *p; ++p)
+		header[headerLength++] = *p;
+	header[headerLength++] = ':';
+	header[headerLength++] = ' ';
+
+	if (headerLength + length + 1 > kRingSize - (_head - _tail))
+	{
+		++_dropped;
+		return;
+	}
+	push(header, headerLength);
+	push(text, length);
+	push("\n", 1);
+}
+
+// Writes as much of the ring as the descriptor accepts without blocking.
+// On a hard error the buffered records are discarded rather than kept
+// around forever. If /proc could not be opened this falls back to plain,
+// possibly blocking writes on the original descriptor.
+void Logger::flush()
+{
+	while (_head != _tail)
+	{
+		size_t offset = _tail % kRingSize;
+		size_t length = _head - _tail;
+		if (length > kRingSize - offset)
+			length = kRingSize - offset;
+
+		ssize_t written = _isSocket ? send(_fd, _ring + offset, length, MSG_DONTWAIT | MSG_NOSIGNAL)
+			: write(_ownFd >= 0 ? _ownFd : _fd, _ring + offset, length);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				_tail = _head;
+			break;
+		}
+		_tail += written;
+	}
+	if (_dropped > 0)
+	{
+		unsigned long dropped = _dropped;
+		_dropped = 0;
+		LogRecord(LOG_WARN, LOG_SERVER) << dropped << " log records dropped";
+		if (_dropped > 0)
+			_dropped = dropped;
+	}
+}
+
+bool Logger::parseLevel(const std::string& name, LogLevel& level)
+{
+	static const char* const names[] = { "debug", "info", "warn", "error", "off" };
+
+	for (size_t i = 0; i <= LOG_OFF; ++i)
+	{
+		if (name == names[i])
+		{
+			level = static_cast<LogLevel>(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+// Comma-separated category names, or "all".
+bool Logger::parseCategories(const std::string& names, int& categories)
+{
+	int parsed = 0;
+	size_t start = 0;
+
+	while (start <= names.size())
+	{
+		size_t end = names.find(',', start);
+		if (end == std::string::npos)
+			end = names.size();
+		std::string name = names.substr(start, end - start);
+		if (name == "all")
+			parsed |= LOG_ALL;
+		else
+		{
+			size_t i = 0;
+			while (i < kCategoryCount && name != kCategoryNames[i])
+				++i;
+			if (i == kCategoryCount)
+				return false;
+			parsed |= 1 << i;
+		}
+		start = end + 1;
+	}
+	categories = parsed;
+	return true;
+}
+
+LogBody::LogBody(const StringView& body) : text(body)
+{
+}
+
+LogRecord::LogRecord(LogLevel level, LogCategory category)
+	: _level(level), _category(category), _length(0)
+{
+}
+
+LogRecord::~LogRecord()
+{
+	Logger::commit(_level, _category, _text, _length);
+}
+
+// Over-long records are cut short and marked with "...".
+void LogRecord::append(const char* data, size_t length)
+{
+	size_t room = kMaxRecord - _length;
+
+	if (length <= room)
+	{
+		std::memcpy(_text + _length, data, length);
+		_length += length;
+		return;
+	}
+	if (room < 3)
+		return;
+	std::memcpy(_text + _length, data, room - 3);
+	std::memcpy(_text + kMaxRecord - 3, "...", 3);
+	_length = kMaxRecord;
+}
+
+void LogRecord::appendUnsigned(unsigned long value)
+{
+	char digits[24];
+	size_t count = 0;
+
+	do
+	{
+		digits[sizeof(digits) - ++count] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+	append(digits + sizeof(digits) - count, count);
+}
+
+LogRecord& LogRecord::operator<<(const char* text)
+{
+	append(text, std::strlen(text));
+	return *this;
+}
+
+LogRecord& LogRecord::operator<<(const std::string& text)
+{
+	append(text.data(), text.size());
+	return *this;
+}
+
+LogRecord& LogRecord::operator<<(const StringView& text)
+{
+	append(text.data(), text.size());
+	return *this;
+}
+
+LogRecord& LogRecord::operator<<(const LogBody& body)
+{
+	if (Logger::logsBodies())
+	{
+		append(": ", 2);
+		append(body.text.data(), body.text.size());
+	}
+	return *this;
+}
+
+LogRecord& LogRecord::operator<<(char c)
+{
+	append(&c, 1);
+	return *this;
+}
+
+LogRecord& LogRecord::operator<<(int value)
+{
+	return *this << static_cast<long>(value);
+}
+
+LogRecord& LogRecord::operator<<(unsigned int value)
+{
+	appendUnsigned(value);
+	return *this;
+}
+
+LogRecord& LogRecord::operator<<(long value)
+{
+	if (value < 0)
+	{
+		append("-", 1);
+		appendUnsigned(-static_cast<unsigned long>(value));
+	}
+	else
+		appendUnsigned(value);
+	return *this;
+}
+
+LogRecord& LogRecord::operator<<(unsigned long value)
+{
+	appendUnsigned(value);
+	return *this;
+}
@@ -0,0 +1,210 @@
+#include "Metrics.hpp"
+#include <cstdarg>
+#include <cstdio>
+
+static void appendFormat(std::string& out, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+LatencyHistogram::LatencyHistogram() : _count(0), _sumNs(0), _maxNs(0)
+{
+	for (unsigned i = 0; i < kBuckets; i++)
+		_counts[i] = 0;
+}
+
+// Values below 4 ns get a bucket each; above that, the top two bits after
+// the leading one pick one of four buckets within its power of two.
+unsigned LatencyHistogram::indexOf(unsigned long long ns)
+{
+	if (ns < kSubBuckets)
+		return static_cast<unsigned>(ns);
+	unsigned bit = 63 - __builtin_clzll(ns);
+	unsigned sub = static_cast<unsigned>(ns >> (bit - 2)) & (kSubBuckets - 1);
+	return kSubBuckets + (bit - 2) * kSubBuckets + sub;
+}
+
+// Largest value filed in the bucket; see record().
+unsigned long long LatencyHistogram::upperBound(unsigned index)
+{
+	if (index < kSubBuckets)
+		return index + 1;
+	unsigned bit = (index - kSubBuckets) / kSubBuckets + 2;
+	unsigned long long mantissa = (index - kSubBuckets) % kSubBuckets + kSubBuckets;
+	return (mantissa + 1) << (bit - 2);
+}
+
+// Files ns by ns - 1, so each bucket runs from just above one edge up to
+// and including the next: 2^n lands in the last bucket below 2^n, not the
+// first one above it.
+void LatencyHistogram::record(unsigned long long ns)
+{
+	++_counts[indexOf(ns > 0 ? ns - 1 : 0)];
+	++_count;
+	_sumNs += ns;
+	if (ns > _maxNs)
+		_maxNs = ns;
+}
+
+unsigned long LatencyHistogram::getCount() const
+{
+	return _count;
+}
+
+unsigned long long LatencyHistogram::getSumNs() const
+{
+	return _sumNs;
+}
+
+unsigned long long LatencyHistogram::getMaxNs() const
+{
+	return _maxNs;
+}
+
+unsigned long long LatencyHistogram::percentileNs(double fraction) const
+{
+	if (_count == 0)
+		return 0;
+	unsigned long rank = static_cast<unsigned long>(fraction * _count);
+	if (rank < _count * fraction || rank == 0)
+		++rank;
+	unsigned long seen = 0;
+	for (unsigned i = 0; i < kBuckets; i++)
+	{
+		seen += _counts[i];
+		if (seen >= rank)
+			return upperBound(i) < _maxNs ? upperBound(i) : _maxNs;
+	}
+	return _maxNs;
+}
+
+// Samples of at most ns, which must be a power of two of 4 or more so it
+// falls on a bucket edge; used for the Prometheus le buckets.
+unsigned long LatencyHistogram::countAtMost(unsigned long long ns) const
+{
+	unsigned long atMost = 0;
+	unsigned limit = indexOf(ns);
+	for (unsigned i = 0; i < limit; i++)
+		atMost += _counts[i];
+	return atMost;
+}
+
+CommandMetrics::CommandMetrics() : bytes(0)
+{
+}
+
+MetricsGauges::MetricsGauges()
+	: clients(0), registered(0), channels(0), throttled(0), timers(0), sendQueueBytes(0), maxSendQueueBytes(0)
+{
+}
+
+Metrics::Metrics(unsigned long nowMs)
+	: startedMs(nowMs), connectionsAccepted(0), bytesReceived(0), linesReceived(0), unknownCommands(0),
+	  throttles(0)
+{
+}
+
+void Metrics::recordCommand(CommandId id, unsigned long long ns)
+{
+	commands[id].latency.record(ns);
+}
+
+// Reasons are server-chosen strings ("Ping timeout", "SendQ exceeded", ...),
+// so the map stays small.
+void Metrics::recordDisconnect(const std::string& reason)
+{
+	++disconnects[reason];
+}
+
+static void appendFormat(std::string& out, const char* format, ...)
+{
+	char buffer[256];
+	va_list args;
+
+	va_start(args, format);
+	int length = std::vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	if (length > 0)
+		out.append(buffer, static_cast<size_t>(length) < sizeof(buffer) ? length : sizeof(buffer) - 1);
+}
+
+static void appendMetric(std::string& out, const char* name, const char* type, const char* help,
+	unsigned long long value)
+{
+	appendFormat(out, "# HELP %s %s\n# TYPE %s %s\n%s %llu\n", name, help, name, type, name, value);
+}
+
+// Prometheus text exposition format, version 0.0.4.
+void Metrics::renderPrometheus(std::string& out, unsigned long nowMs, const MetricsGauges& gauges,
+	const std::vector<PoolStats>& pools) const
+{
+	appendMetric(out, "ircserv_uptime_seconds", "gauge", "Seconds since the server started.",
+		(nowMs - startedMs) / 1000);
+	appendMetric(out, "ircserv_connections_accepted_total", "counter", "Client connections accepted.",
+		connectionsAccepted);
+	appendMetric(out, "ircserv_received_bytes_total", "counter", "Bytes read from clients.", bytesReceived);
+	appendMetric(out, "ircserv_sent_bytes_total", "counter", "Bytes written to clients.", send.bytesSent);
+	appendMetric(out, "ircserv_received_lines_total", "counter", "Lines read from clients.", linesReceived);
+	appendMetric(out, "ircserv_sent_lines_total", "counter", "Lines written to clients.", send.linesSent);
+	appendMetric(out, "ircserv_write_calls_total", "counter", "writev() calls on client sockets.",
+		send.writeCalls);
+	appendMetric(out, "ircserv_unknown_commands_total", "counter", "Lines with an unknown or malformed command.",
+		unknownCommands);
+	appendMetric(out, "ircserv_throttles_total", "counter", "Times a client's input was deferred by flood control.",
+		throttles);
+
+	out.append("# HELP ircserv_disconnects_total Connections closed, by reason.\n"
+		"# TYPE ircserv_disconnects_total counter\n");
+	for (std::map<std::string, unsigned long>::const_iterator it = disconnects.begin(); it != disconnects.end(); ++it)
+		appendFormat(out, "ircserv_disconnects_total{reason=\"%s\"} %lu\n", it->first.c_str(), it->second);
+
+	appendMetric(out, "ircserv_clients", "gauge", "Connected clients.", gauges.clients);
+	appendMetric(out, "ircserv_registered_clients", "gauge", "Clients that completed registration.",
+		gauges.registered);
+	appendMetric(out, "ircserv_channels", "gauge", "Channels.", gauges.channels);
+	appendMetric(out, "ircserv_throttled_clients", "gauge", "Clients whose input is deferred.", gauges.throttled);
+	appendMetric(out, "ircserv_timers", "gauge", "Pending client timers.", gauges.timers);
+	appendMetric(out, "ircserv_sendq_bytes", "gauge", "Bytes queued for all clients.", gauges.sendQueueBytes);
+	appendMetric(out, "ircserv_sendq_max_bytes", "gauge", "Largest send queue of any client.",
+		gauges.maxSendQueueBytes);
+
+	out.append("# HELP ircserv_pool_objects Pooled objects, by pool and state.\n"
+		"# TYPE ircserv_pool_objects gauge\n");
+	for (size_t i = 0; i < pools.size(); i++)
+	{
+		appendFormat(out, "ircserv_pool_objects{pool=\"%s\",state=\"in_use\"} %lu\n", pools[i].name,
+			static_cast<unsigned long>(pools[i].inUse));
+		appendFormat(out, "ircserv_pool_objects{pool=\"%s\",state=\"free\"} %lu\n", pools[i].name,
+			static_cast<unsigned long>(pools[i].free));
+	}
+	out.append("# HELP ircserv_pool_reserved_bytes Bytes mapped by each pool.\n"
+		"# TYPE ircserv_pool_reserved_bytes gauge\n");
+	for (size_t i = 0; i < pools.size(); i++)
+		appendFormat(out, "ircserv_pool_reserved_bytes{pool=\"%s\"} %lu\n", pools[i].name,
+			static_cast<unsigned long>(pools[i].bytesReserved));
+
+	out.append("# HELP ircserv_command_received_bytes_total Bytes of command lines, by command.\n"
+		"# TYPE ircserv_command_received_bytes_total counter\n");
+	for (int id = 0; id < CMD_COUNT; id++)
+	{
+		appendFormat(out, "ircserv_command_received_bytes_total{command=\"%s\"} %lu\n",
+			Command::lookup(static_cast<CommandId>(id))->name, commands[id].bytes);
+	}
+
+	// Bucket bounds are powers of two nanoseconds, from 128 ns to about 17 ms.
+	out.append("# HELP ircserv_command_duration_seconds Time spent running each command.\n"
+		"# TYPE ircserv_command_duration_seconds histogram\n");
+	for (int id = 0; id < CMD_COUNT; id++)
+	{
+		const char* name = Command::lookup(static_cast<CommandId>(id))->name;
+		const LatencyHistogram& latency = commands[id].latency;
+		for (unsigned bit = 7; bit <= 24; bit++)
+		{
+			appendFormat(out, "ircserv_command_duration_seconds_bucket{command=\"%s\",le=\"%.9g\"} %lu\n",
+				name, (1ULL << bit) / 1e9, latency.countAtMost(1ULL << bit));
+		}
+		appendFormat(out, "ircserv_command_duration_seconds_bucket{command=\"%s\",le=\"+Inf\"} %lu\n",
+			name, latency.getCount());
+		appendFormat(out, "ircserv_command_duration_seconds_sum{command=\"%s\"} %.9f\n",
+			name, latency.getSumNs() / 1e9);
+		appendFormat(out, "ircserv_command_duration_seconds_count{command=\"%s\"} %lu\n",
+			name, latency.getCount());
+	}
+}
@@ -0,0 +1,261 @@
+#include "MetricsExporter.hpp"
+#include "Server.hpp"
+#include "Reactor.hpp"
+#include "Logger.hpp"
+#include "Utils.hpp"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+MetricsExporter::Connection::Connection() : sent(0), acceptedAt(0)
+{
+}
+
+// Accepts one pending scrape connection, already non-blocking and
+// close-on-exec, like the server's own listener does.
+static int acceptConnection(int listenFd)
+{
+#ifdef __linux__
+	return accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+	int fd = accept(listenFd, NULL, NULL);
+	if (fd >= 0 && (fcntl(fd, F_SETFL, O_NONBLOCK) < 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) < 0))
+	{
+		close(fd);
+		errno = ECONNABORTED;
+		return -1;
+	}
+	return fd;
+#endif
+}
+
+MetricsExporter::MetricsExporter(Server* server, Reactor* reactor, int port)
+	: _server(server), _reactor(reactor), _listenFd(-1), _acceptPaused(false), _acceptPausedAt(0)
+{
+	_listenFd = socket(AF_INET, SOCK_STREAM, 0);
+	if (_listenFd < 0)
+		throw std::runtime_error("Failed to create metrics socket");
+
+	int opt = 1;
+	struct sockaddr_in addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	if (setsockopt(_listenFd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0
+		|| fcntl(_listenFd, F_SETFL, O_NONBLOCK) < 0
+		|| bind(_listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0
+		|| listen(_listenFd, 16) < 0
+		|| !_reactor->add(_listenFd, Reactor::READ))
+	{
+		close(_listenFd);
+		throw std::runtime_error("Failed to set up metrics endpoint");
+	}
+	LOG(LOG_INFO, LOG_SERVER) << "Metrics on http://127.0.0.1:" << port << "/metrics";
+}
+
+MetricsExporter::~MetricsExporter()
+{
+	while (!_connections.empty())
+		closeConnection(_connections.begin()->first);
+	_reactor->remove(_listenFd);
+	close(_listenFd);
+}
+
+bool MetricsExporter::handles(int fd) const
+{
+	return fd == _listenFd || _connections.count(fd) > 0;
+}
+
+void MetricsExporter::handleEvent(int fd, int events, unsigned long nowMs)
+{
+	if (fd == _listenFd)
+	{
+		acceptConnections(nowMs);
+		return;
+	}
+	std::map<int, Connection>::iterator it = _connections.find(fd);
+	if (it == _connections.end())
+		return;
+	if (!it->second.response.empty())
+	{
+		if (events & (Reactor::WRITE | Reactor::HANGUP))
+			writeResponse(fd, it->second);
+	}
+	else if (events & (Reactor::READ | Reactor::HANGUP))
+		readRequest(fd, it->second);
+}
+
+void MetricsExporter::acceptConnections(unsigned long nowMs)
+{
+	while (true)
+	{
+		int fd = acceptConnection(_listenFd);
+		if (fd < 0)
+		{
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			// Out of descriptors: the listening socket stays readable, so
+			// stop watching it until one is freed, as the server does.
+			if (errno == EMFILE || errno == ENFILE)
+				pauseAccepting(nowMs);
+			return;
+		}
+		if (_connections.size() >= kMaxConnections || !_reactor->add(fd, Reactor::READ))
+		{
+			close(fd);
+			continue;
+		}
+		_connections[fd].acceptedAt = nowMs;
+	}
+}
+
+void MetricsExporter::pauseAccepting(unsigned long nowMs)
+{
+	if (_acceptPaused || !_reactor->modify(_listenFd, 0))
+		return;
+	_acceptPaused = true;
+	_acceptPausedAt = nowMs;
+}
+
+// Called once a descriptor may have been freed: when a scrape connection is
+// closed, or kAcceptRetryMs after pausing for anything the server freed.
+// Re-arming reports the listening socket again if connections are waiting;
+// if the reactor cannot take the change, the next call tries again.
+void MetricsExporter::resumeAccepting()
+{
+	if (!_acceptPaused || !_reactor->modify(_listenFd, Reactor::READ))
+		return;
+	_acceptPaused = false;
+}
+
+// Drops connections that have had kConnectionTimeoutMs to send a request and
+// take the response, so idle sockets cannot hold the connection limit, and
+// retries a paused listener.
+void MetricsExporter::expire(unsigned long nowMs)
+{
+	std::map<int, Connection>::iterator it = _connections.begin();
+	while (it != _connections.end())
+	{
+		int fd = it->first;
+		bool expired = nowMs - it->second.acceptedAt >= kConnectionTimeoutMs;
+		++it;
+		if (expired)
+			closeConnection(fd);
+	}
+	if (_acceptPaused && nowMs - _acceptPausedAt >= kAcceptRetryMs)
+		resumeAccepting();
+}
+
+// Milliseconds until expire() has work to do, or -1 if nothing is pending.
+int MetricsExporter::getTimeout(unsigned long nowMs) const
+{
+	unsigned long earliest = 0;
+	bool pending = false;
+
+	for (std::map<int, Connection>::const_iterator it = _connections.begin(); it != _connections.end(); ++it)
+	{
+		unsigned long deadline = it->second.acceptedAt + kConnectionTimeoutMs;
+		if (!pending || deadline < earliest)
+			earliest = deadline;
+		pending = true;
+	}
+	if (_acceptPaused && (!pending || _acceptPausedAt + kAcceptRetryMs < earliest))
+	{
+		earliest = _acceptPausedAt + kAcceptRetryMs;
+		pending = true;
+	}
+	if (!pending)
+		return -1;
+	if (earliest <= nowMs)
+		return 0;
+	return static_cast<int>(earliest - nowMs);
+}
+
+void MetricsExporter::readRequest(int fd, Connection& connection)
+{
+	char buffer[1024];
+
+	while (connection.response.empty())
+	{
+		ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+		if (received < 0 && errno == EINTR)
+			continue;
+		if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return;
+		if (received <= 0)
+		{
+			closeConnection(fd);
+			return;
+		}
+		connection.request.append(buffer, received);
+		if (connection.request.find("\r\n\r\n") != std::string::npos)
+		{
+			buildResponse(connection);
+			writeResponse(fd, connection);
+			return;
+		}
+		if (connection.request.size() > kMaxRequest)
+		{
+			closeConnection(fd);
+			return;
+		}
+	}
+}
+
+void MetricsExporter::buildResponse(Connection& connection)
+{
+	std::string body;
+	const char* status;
+
+	if (connection.request.compare(0, 13, "GET /metrics ") == 0)
+	{
+		status = "200 OK";
+		_server->renderMetrics(body);
+	}
+	else
+	{
+		status = "404 Not Found";
+		body = "Not found\n";
+	}
+	connection.response = std::string("HTTP/1.0 ") + status + "\r\n"
+		"Content-Type: text/plain; version=0.0.4\r\n"
+		"Content-Length: " + Utils::intToString(static_cast<int>(body.size())) + "\r\n"
+		"Connection: close\r\n\r\n" + body;
+}
+
+// Closes the connection once the whole response is out; until then write
+// interest stays registered.
+void MetricsExporter::writeResponse(int fd, Connection& connection)
+{
+	while (connection.sent < connection.response.size())
+	{
+		ssize_t sent = send(fd, connection.response.data() + connection.sent,
+			connection.response.size() - connection.sent, 0);
+		if (sent < 0 && errno == EINTR)
+			continue;
+		if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			if (_reactor->modify(fd, Reactor::WRITE))
+				return;
+			break;
+		}
+		if (sent < 0)
+			break;
+		connection.sent += sent;
+	}
+	closeConnection(fd);
+}
+
+void MetricsExporter::closeConnection(int fd)
+{
+	_reactor->remove(fd);
+	close(fd);
+	_connections.erase(fd);
+	resumeAccepting();
+}
@@ -11,6 +11,8 @@
 /* ************************************************************************** */
 
 #include "Parser.hpp"
+#include "Logger.hpp"
+#include <cstring>
 #include <stdexcept>
 
 Parser::Parser() {}
@@ -26,80 +28,89 @@ Parser& Parser::operator=(const Parser& other) {
 
 Parser::~Parser() {}
 
-Command Parser::parseMessage(const std::string& raw)
+// Tokenises one line (normally a CRLF-terminated frame from LineBuffer)
+// without copying it: the returned Command only points into `raw`.
+Command Parser::parseMessage(const char* raw, size_t length)
 {
     Command cmd;
-    std::string line = raw;
+    size_t end = length;
     size_t pos = 0;
 
-    if (raw.empty())
+    if (length == 0)
     {
         cmd.setValid(false);
         return cmd;
     }
-    if (line.length() > 512)
+    if (length > 512)
     {
-        std::cerr << "Message exceeds 512 bytes limit" << std::endl;
+        LOG(LOG_DEBUG, LOG_PARSER) << "Message exceeds 512 bytes limit";
         cmd.setValid(false);
         return cmd;
     }
-    if (line.size() >= 2 && line.substr(line.size() - 2) == "\r\n")
-        line.erase(line.size() - 2);
-    if (raw.find('\n') != std::string::npos &&
-        raw.find("\r\n") == std::string::npos)
+    if (length >= 2 && raw[length - 2] == '\r' && raw[length - 1] == '\n')
+        end = length - 2;
+    else if (std::memchr(raw, '\n', length))
     {
-        std::cerr << "Malformed line ending" << std::endl;
+        LOG(LOG_DEBUG, LOG_PARSER) << "Malformed line ending";
         cmd.setValid(false);
         return cmd;
     }
-    if (!line.empty() && line[0] == ':')
+    if (end > 0 && raw[0] == ':')
     {
-        size_t space = line.find(' ');
-        if (space == std::string::npos)
+        const char* space = static_cast<const char*>(std::memchr(raw, ' ', end));
+        if (!space)
         {
-            std::cerr << "Malformed prefix" << std::endl;
+            LOG(LOG_DEBUG, LOG_PARSER) << "Malformed prefix";
             cmd.setValid(false);
             return cmd;
         }
-        cmd.setPrefix(line.substr(1, space - 1));
-        pos = space + 1;
+        cmd.setPrefix(StringView(raw + 1, space - raw - 1));
+        pos = space - raw + 1;
+    }
+    const char* space = static_cast<const char*>(std::memchr(raw + pos, ' ', end - pos));
+    if (!space)
+    {
+        cmd.setCommand(StringView(raw + pos, end - pos));
+        pos = end;
     }
-    size_t space = line.find(' ', pos);
-    if (space == std::string::npos)
-        cmd.setCommand(line.substr(pos));
     else
     {
-        cmd.setCommand(line.substr(pos, space - pos));
-        pos = space + 1;
+        cmd.setCommand(StringView(raw + pos, space - raw - pos));
+        pos = space - raw + 1;
     }
     if (cmd.getCommand().empty())
     {
-        std::cerr << "Empty command" << std::endl;
+        LOG(LOG_DEBUG, LOG_PARSER) << "Empty command";
         cmd.setValid(false);
         return cmd;
     }
-    if (!Command::isValidCommand(cmd.getCommand()))
+    cmd.setInfo(Command::lookup(cmd.getCommand()));
+    if (!cmd.getInfo())
     {
-        std::cerr << "Unknown command: " << cmd.getCommand() << std::endl;
+        LOG(LOG_DEBUG, LOG_PARSER) << "Unknown command: " << cmd.getCommand();
         cmd.setValid(false);
         return cmd;
     }
-    while (pos < line.size())
+    while (pos < end)
     {
-        if (line[pos] == ':')
+        // RFC 2812: after 14 middle parameters the rest of the line is the
+        // trailing one, with or without its leading ':'.
+        if (raw[pos] == ':' || cmd.getParamCount() == Command::MAX_PARAMS - 1)
         {
-            cmd.setTrailing(line.substr(pos + 1));
+            if (raw[pos] == ':')
+                ++pos;
+            cmd.setTrailing(StringView(raw + pos, end - pos));
             break;
         }
-        size_t nextSpace = line.find(' ', pos);
-        if (nextSpace == std::string::npos)
+        const char* nextSpace = static_cast<const char*>(std::memchr(raw + pos, ' ', end - pos));
+        if (!nextSpace)
         {
-            cmd.addParam(line.substr(pos));
+            cmd.addParam(StringView(raw + pos, end - pos));
             break;
         }
-        cmd.addParam(line.substr(pos, nextSpace - pos));
+        cmd.addParam(StringView(raw + pos, nextSpace - raw - pos));
 
-        pos = nextSpace + 1;
+        pos = nextSpace - raw + 1;
     }
     return cmd;
 }
@@ -108,26 +119,3 @@ bool Parser::isComplete(const std::string& buffer)
 {
     return buffer.find("\r\n") != std::string::npos;
 }
-
-std::vector<std::string> Parser::extractMessages(std::string& buffer)
-{
-    std::vector<std::string> messages;
-    size_t pos;
-
-    if (buffer.empty())
-        return messages;
-
-    while ((pos = buffer.find("\r\n")) != std::string::npos) 
-    {
-        if (pos == 0)
-        {
-            buffer.erase(0, 2);
-            continue;
-        }
-        std::string line = buffer.substr(0, pos + 2);
-        messages.push_back(line);
-        buffer.erase(0, pos + 2);
-    }
-    return messages;
-}
-
@@ -0,0 +1,118 @@
+#include "Payload.hpp"
+#include "Pool.hpp"
+#include <cstring>
+
+// Blocks come from a fixed-size pool and their bytes from the buffer slab,
+// so queueing a line does not touch the general heap.
+ObjectPool& Payload::blockPool()
+{
+	static ObjectPool pool("payload", sizeof(Block));
+	return pool;
+}
+
+Payload::Block* Payload::createBlock(size_t capacity)
+{
+	Block* block = static_cast<Block*>(blockPool().allocate());
+	block->refs = 1;
+	block->lines = 0;
+	block->size = 0;
+	block->bytes = BufferPool::allocate(capacity, block->capacity);
+	return block;
+}
+
+Payload::Payload() : _block(NULL)
+{
+}
+
+Payload::Payload(const std::string& line) : _block(createBlock(line.size() + 2))
+{
+	std::memcpy(_block->bytes, line.data(), line.size());
+	std::memcpy(_block->bytes + line.size(), "\r\n", 2);
+	_block->size = line.size() + 2;
+	_block->lines = 1;
+}
+
+Payload::Payload(const Payload& other) : _block(other._block)
+{
+	if (_block)
+		++_block->refs;
+}
+
+Payload& Payload::operator=(const Payload& other)
+{
+	if (_block != other._block)
+	{
+		release();
+		_block = other._block;
+		if (_block)
+			++_block->refs;
+	}
+	return *this;
+}
+
+Payload::~Payload()
+{
+	release();
+}
+
+void Payload::release()
+{
+	if (_block && --_block->refs == 0)
+	{
+		BufferPool::release(_block->bytes, _block->capacity);
+		blockPool().release(_block);
+	}
+	_block = NULL;
+}
+
+const char* Payload::data() const
+{
+	return _block ? _block->bytes : "";
+}
+
+size_t Payload::size() const
+{
+	return _block ? _block->size : 0;
+}
+
+size_t Payload::lineCount() const
+{
+	return _block ? _block->lines : 0;
+}
+
+bool Payload::isExclusive() const
+{
+	return _block && _block->refs == 1;
+}
+
+// Appends the concatenated parts plus CRLF as one more line. Must only be
+// called on an empty or exclusive payload, since other holders would see
+// the bytes change under them.
+void Payload::appendLine(const char* const* parts, const size_t* lengths, size_t count)
+{
+	size_t total = 2;
+
+	for (size_t i = 0; i < count; ++i)
+		total += lengths[i];
+	if (!_block)
+		_block = createBlock(total);
+	else if (_block->size + total > _block->capacity)
+	{
+		size_t capacity;
+		char* bytes = BufferPool::allocate(_block->size + total, capacity);
+		std::memcpy(bytes, _block->bytes, _block->size);
+		BufferPool::release(_block->bytes, _block->capacity);
+		_block->bytes = bytes;
+		_block->capacity = capacity;
+	}
+
+	char* out = _block->bytes + _block->size;
+	for (size_t i = 0; i < count; ++i)
+	{
+		std::memcpy(out, parts[i], lengths[i]);
+		out += lengths[i];
+	}
+	std::memcpy(out, "\r\n", 2);
+	_block->size += total;
+	++_block->lines;
+}
@@ -0,0 +1,249 @@
+#include "Pool.hpp"
+#include <new>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Objects start this far into their slot; the gap holds the owning chunk,
+// and keeps objects 16-byte aligned.
+static const size_t kSlotHeader = 16;
+
+// Aim for chunks of about this size, but never fewer than kMinPerChunk
+// objects per chunk.
+static const size_t kChunkTarget = 64 * 1024;
+static const size_t kMinPerChunk = 4;
+
+static const size_t kMinBufferClass = 64;
+static const size_t kMaxBufferClass = 16 * 1024;
+static const size_t kBufferClassCount = 9;
+
+ObjectPool* ObjectPool::_registry = NULL;
+
+ObjectPool::ObjectPool(const char* name, size_t objectSize)
+	: _name(name), _objectSize(objectSize), _chunks(NULL), _free(NULL),
+	  _inUse(0), _freeCount(0), _highWater(0), _chunkCount(0), _nextPool(_registry)
+{
+	if (objectSize < sizeof(FreeSlot))
+		objectSize = sizeof(FreeSlot);
+	_slotSize = kSlotHeader + (objectSize + 15) / 16 * 16;
+	_perChunk = kChunkTarget / _slotSize;
+	if (_perChunk < kMinPerChunk)
+		_perChunk = kMinPerChunk;
+	_registry = this;
+}
+
+ObjectPool::~ObjectPool()
+{
+	for (ObjectPool** link = &_registry; *link; link = &(*link)->_nextPool)
+	{
+		if (*link == this)
+		{
+			*link = _nextPool;
+			break;
+		}
+	}
+	while (_chunks)
+	{
+		Chunk* next = _chunks->next;
+		munmap(_chunks, _chunks->bytes);
+		_chunks = next;
+	}
+}
+
+ObjectPool::Chunk*& ObjectPool::ownerOf(void* object)
+{
+	return *reinterpret_cast<Chunk**>(static_cast<char*>(object) - kSlotHeader);
+}
+
+// Maps one more chunk and threads its slots onto the free list.
+bool ObjectPool::grow()
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t header = (sizeof(Chunk) + 15) / 16 * 16;
+	size_t bytes = (header + _perChunk * _slotSize + page - 1) / page * page;
+	void* memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED)
+		return false;
+
+	Chunk* chunk = static_cast<Chunk*>(memory);
+	chunk->next = _chunks;
+	chunk->used = 0;
+	chunk->bytes = bytes;
+	chunk->releasing = false;
+	_chunks = chunk;
+	++_chunkCount;
+
+	char* slots = static_cast<char*>(memory) + header;
+	for (size_t i = _perChunk; i-- > 0; )
+	{
+		void* object = slots + i * _slotSize + kSlotHeader;
+		ownerOf(object) = chunk;
+		FreeSlot* slot = static_cast<FreeSlot*>(object);
+		slot->next = _free;
+		_free = slot;
+	}
+	_freeCount += _perChunk;
+	return true;
+}
+
+void* ObjectPool::allocate()
+{
+	if (!_free && !grow())
+		throw std::bad_alloc();
+
+	FreeSlot* slot = _free;
+	_free = slot->next;
+	--_freeCount;
+	++ownerOf(slot)->used;
+	if (++_inUse > _highWater)
+		_highWater = _inUse;
+	return slot;
+}
+
+void ObjectPool::release(void* object)
+{
+	if (!object)
+		return;
+
+	--ownerOf(object)->used;
+	FreeSlot* slot = static_cast<FreeSlot*>(object);
+	slot->next = _free;
+	_free = slot;
+	++_freeCount;
+	--_inUse;
+}
+
+// Unmaps chunks with no live objects and returns the bytes released. One
+// empty chunk is kept as a reserve, and nothing happens until at least two
+// chunks' worth of slots are free, so steady churn does not map and unmap
+// the same chunk over and over.
+size_t ObjectPool::trim()
+{
+	if (_freeCount < 2 * _perChunk)
+		return 0;
+
+	size_t releasing = 0;
+	bool keptSpare = false;
+	for (Chunk* chunk = _chunks; chunk; chunk = chunk->next)
+	{
+		if (chunk->used != 0)
+			continue;
+		if (!keptSpare)
+			keptSpare = true;
+		else
+		{
+			chunk->releasing = true;
+			++releasing;
+		}
+	}
+	if (releasing == 0)
+		return 0;
+
+	FreeSlot** link = &_free;
+	while (*link)
+	{
+		if (ownerOf(*link)->releasing)
+			*link = (*link)->next;
+		else
+			link = &(*link)->next;
+	}
+
+	size_t released = 0;
+	Chunk** chunkLink = &_chunks;
+	while (*chunkLink)
+	{
+		Chunk* chunk = *chunkLink;
+		if (!chunk->releasing)
+		{
+			chunkLink = &chunk->next;
+			continue;
+		}
+		*chunkLink = chunk->next;
+		released += chunk->bytes;
+		_freeCount -= _perChunk;
+		--_chunkCount;
+		munmap(chunk, chunk->bytes);
+	}
+	return released;
+}
+
+PoolStats ObjectPool::getStats() const
+{
+	PoolStats stats;
+	size_t bytes = 0;
+
+	for (const Chunk* chunk = _chunks; chunk; chunk = chunk->next)
+		bytes += chunk->bytes;
+	stats.name = _name;
+	stats.objectSize = _objectSize;
+	stats.inUse = _inUse;
+	stats.free = _freeCount;
+	stats.highWater = _highWater;
+	stats.chunks = _chunkCount;
+	stats.bytesReserved = bytes;
+	return stats;
+}
+
+void ObjectPool::collectStats(std::vector<PoolStats>& stats)
+{
+	stats.clear();
+	for (ObjectPool* pool = _registry; pool; pool = pool->_nextPool)
+		stats.push_back(pool->getStats());
+}
+
+size_t ObjectPool::trimAll()
+{
+	size_t released = 0;
+
+	for (ObjectPool* pool = _registry; pool; pool = pool->_nextPool)
+		released += pool->trim();
+	return released;
+}
+
+// The pool for class i holds buffers of kMinBufferClass << i bytes; built on
+// first use so that pools a process never needs are never mapped.
+static ObjectPool& bufferClass(size_t index)
+{
+	static const char* const names[kBufferClassCount] = {
+		"buffer-64", "buffer-128", "buffer-256", "buffer-512", "buffer-1k",
+		"buffer-2k", "buffer-4k", "buffer-8k", "buffer-16k"
+	};
+	static ObjectPool* pools[kBufferClassCount];
+
+	if (!pools[index])
+		pools[index] = new ObjectPool(names[index], kMinBufferClass << index);
+	return *pools[index];
+}
+
+char* BufferPool::allocate(size_t wanted, size_t& capacity)
+{
+	if (wanted > kMaxBufferClass)
+	{
+		capacity = wanted;
+		return static_cast<char*>(::operator new(wanted));
+	}
+
+	size_t index = 0;
+	capacity = kMinBufferClass;
+	while (capacity < wanted)
+	{
+		capacity <<= 1;
+		++index;
+	}
+	return static_cast<char*>(bufferClass(index).allocate());
+}
+
+void BufferPool::release(char* data, size_t capacity)
+{
+	if (!data)
+		return;
+	if (capacity > kMaxBufferClass)
+	{
+		::operator delete(data);
+		return;
+	}
+
+	size_t index = 0;
+	for (size_t size = kMinBufferClass; size < capacity; size <<= 1)
+		++index;
+	bufferClass(index).release(data);
+}
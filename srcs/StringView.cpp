@@ -0,0 +1,58 @@
+#include "StringView.hpp"
+#include <cstring>
+
+StringView::StringView() : _data(""), _size(0)
+{
+}
+
+StringView::StringView(const char* data, size_t size) : _data(data), _size(size)
+{
+}
+
+StringView::StringView(const char* str) : _data(str), _size(std::strlen(str))
+{
+}
+
+StringView::StringView(const std::string& str) : _data(str.data()), _size(str.size())
+{
+}
+
+const char* StringView::data() const
+{
+	return _data;
+}
+
+size_t StringView::size() const
+{
+	return _size;
+}
+
+bool StringView::empty() const
+{
+	return _size == 0;
+}
+
+char StringView::operator[](size_t index) const
+{
+	return _data[index];
+}
+
+std::string StringView::str() const
+{
+	return std::string(_data, _size);
+}
+
+bool StringView::operator==(const StringView& other) const
+{
+	return _size == other._size && std::memcmp(_data, other._data, _size) == 0;
+}
+
+bool StringView::operator!=(const StringView& other) const
+{
+	return !(*this == other);
+}
+
+std::ostream& operator<<(std::ostream& os, const StringView& view)
+{
+	return os.write(view.data(), view.size());
+}
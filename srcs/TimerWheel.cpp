@@ -0,0 +1,178 @@
+#include "TimerWheel.hpp"
+#include <climits>
+
+Timer::Timer() : _prev(NULL), _next(NULL), _expires(0), _level(0), _index(0), _kind(0), _owner(NULL)
+{
+}
+
+void Timer::setOwner(void* owner)
+{
+	_owner = owner;
+}
+
+void* Timer::getOwner() const
+{
+	return _owner;
+}
+
+int Timer::getKind() const
+{
+	return _kind;
+}
+
+bool Timer::isPending() const
+{
+	return _next != NULL;
+}
+
+// Slot heads are sentinel nodes, so linking and unlinking never branch on
+// an empty list.
+TimerWheel::TimerWheel(unsigned long nowMs, unsigned long tickMs)
+	: _start(nowMs), _tickMs(tickMs ? tickMs : 1), _tick(0), _count(0)
+{
+	for (unsigned level = 0; level < kLevels; ++level)
+	{
+		_occupied[level] = 0;
+		for (unsigned i = 0; i < kSlots; ++i)
+		{
+			_slots[level][i]._prev = &_slots[level][i];
+			_slots[level][i]._next = &_slots[level][i];
+		}
+	}
+}
+
+// Files the timer under the innermost level whose span still reaches its
+// expiry tick. Expiries beyond the outer level are filed in its last slot
+// before the current one, so they can never land in the slot being
+// cascaded; they keep their real expiry and are filed again, closer in,
+// each time that slot cascades.
+void TimerWheel::place(Timer& timer)
+{
+	unsigned long horizon = (1UL << (kSlotBits * kLevels)) - (1UL << (kSlotBits * (kLevels - 1)));
+	unsigned long slotTick = timer._expires;
+	if (slotTick - _tick > horizon)
+		slotTick = _tick + horizon;
+
+	unsigned long delta = slotTick - _tick;
+	unsigned level = 0;
+	while (level + 1 < kLevels && delta >= (1UL << (kSlotBits * (level + 1))))
+		++level;
+
+	unsigned index = (slotTick >> (kSlotBits * level)) & (kSlots - 1);
+	Timer& head = _slots[level][index];
+	timer._level = level;
+	timer._index = index;
+	timer._prev = head._prev;
+	timer._next = &head;
+	head._prev->_next = &timer;
+	head._prev = &timer;
+	_occupied[level] |= 1ULL << index;
+}
+
+void TimerWheel::unlink(Timer& timer)
+{
+	timer._prev->_next = timer._next;
+	timer._next->_prev = timer._prev;
+	timer._prev = NULL;
+	timer._next = NULL;
+
+	Timer& head = _slots[timer._level][timer._index];
+	if (head._next == &head)
+		_occupied[timer._level] &= ~(1ULL << timer._index);
+}
+
+void TimerWheel::schedule(Timer& timer, int kind, unsigned long delayMs)
+{
+	if (timer.isPending())
+		cancel(timer);
+	timer._kind = kind;
+	// One tick of slack so a timer never fires early, whatever point of
+	// the current tick we are at.
+	timer._expires = _tick + delayMs / _tickMs + 1;
+	place(timer);
+	++_count;
+}
+
+void TimerWheel::cancel(Timer& timer)
+{
+	if (!timer.isPending())
+		return;
+	unlink(timer);
+	--_count;
+}
+
+// Re-files every timer of the level's current slot; they now fall into a
+// lower level.
+void TimerWheel::cascade(unsigned level)
+{
+	unsigned index = (_tick >> (kSlotBits * level)) & (kSlots - 1);
+	Timer& head = _slots[level][index];
+
+	while (head._next != &head)
+	{
+		Timer& timer = *head._next;
+		unlink(timer);
+		place(timer);
+	}
+}
+
+// Turns the wheel up to nowMs and appends every timer that expired, in
+// expiry order, to `expired`. Expired timers are no longer pending.
+void TimerWheel::advance(unsigned long nowMs, std::vector<Timer*>& expired)
+{
+	unsigned long target = nowMs > _start ? (nowMs - _start) / _tickMs : 0;
+
+	while (_tick < target)
+	{
+		if (_count == 0)
+		{
+			_tick = target;
+			break;
+		}
+		++_tick;
+		unsigned index = _tick & (kSlots - 1);
+		for (unsigned level = 1; index == 0 && level < kLevels; ++level)
+		{
+			cascade(level);
+			index = (_tick >> (kSlotBits * level)) & (kSlots - 1);
+		}
+
+		Timer& head = _slots[0][_tick & (kSlots - 1)];
+		while (head._next != &head)
+		{
+			Timer& timer = *head._next;
+			unlink(timer);
+			--_count;
+			expired.push_back(&timer);
+		}
+	}
+}
+
+// Milliseconds until the next tick that either expires a timer or has to
+// cascade one down, or -1 when nothing is scheduled.
+int TimerWheel::getTimeout(unsigned long nowMs) const
+{
+	if (_count == 0)
+		return -1;
+
+	unsigned index = _tick & (kSlots - 1);
+	unsigned long ticks = kSlots - index;
+	if (index + 1 < kSlots)
+	{
+		unsigned long long later = _occupied[0] & (~0ULL << (index + 1));
+		if (later)
+			ticks = __builtin_ctzll(later) - index;
+	}
+
+	unsigned long wake = _start + (_tick + ticks) * _tickMs;
+	if (wake <= nowMs)
+		return 0;
+	if (wake - nowMs > static_cast<unsigned long>(INT_MAX))
+		return INT_MAX;
+	return static_cast<int>(wake - nowMs);
+}
+
+size_t TimerWheel::size() const
+{
+	return _count;
+}
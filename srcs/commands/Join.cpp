@@ -8,35 +8,22 @@
 
 void Server::handleJoin(Client* client, const Command& cmd)
 {
-	if (!client->isRegistered())
-	{
-		client->sendMessage(Utils::formatReply(ERR_NOTREGISTERED, "*", ":You have not registered"));
-		return;
-	}
-	std::vector<std::string> params = cmd.getParams();
-	if (params.empty())
-	{
-		client->sendMessage(Utils::formatReply(ERR_NEEDMOREPARAMS,
-			client->getNickname(), "JOIN :Not enough parameters"));
-		return;
-	}
-	if (params[0] == "0")
+	if (cmd.getParam(0) == "0")
 	{
 		handlePartAll(client);
 		return;
 	}
-	std::vector<std::string> channels = Utils::splitByComma(params[0]);
+	std::vector<std::string> channels = Utils::splitByComma(cmd.getParam(0));
 	std::vector<std::string> keys;
-	if (params.size() > 1)
-		keys = Utils::splitByComma(params[1]);
+	if (cmd.getParamCount() > 1)
+		keys = Utils::splitByComma(cmd.getParam(1));
 	for (size_t i = 0; i < channels.size(); ++i)
 	{
 		std::string channelName = channels[i];
 		std::string key = (i < keys.size()) ? keys[i] : "";
 		if (!Utils::isValidChannelName(channelName))
 		{
-			client->sendMessage(Utils::formatReply(ERR_BADCHANMASK,
-				client->getNickname(), channelName + " :Bad Channel Mask"));
+			client->sendReply(ERR_BADCHANMASK, client->getNickname(), channelName, ":Bad Channel Mask");
 			continue;
 		}
 		Channel* channel = getChannel(channelName);
@@ -52,60 +39,49 @@ void Server::handleJoin(Client* client, const Command& cmd)
 		{
 			if (channel->isInviteOnly() && !channel->isInvited(client))
 			{
-				client->sendMessage(Utils::formatReply(ERR_INVITEONLYCHAN,
-					client->getNickname(), channelName + " :Cannot join channel (+i)"));
+				client->sendReply(ERR_INVITEONLYCHAN, client->getNickname(), channelName,
+					":Cannot join channel (+i)");
 				continue;
 			}
 			if (channel->hasKey() && !channel->checkKey(key))
 			{
-				client->sendMessage(Utils::formatReply(ERR_BADCHANNELKEY,
-					client->getNickname(), channelName + " :Cannot join channel (+k)"));
+				client->sendReply(ERR_BADCHANNELKEY, client->getNickname(), channelName,
+					":Cannot join channel (+k)");
 				continue;
 			}
 			if (channel->isFull())
 			{
-				client->sendMessage(Utils::formatReply(ERR_CHANNELISFULL,
-					client->getNickname(), channelName + " :Cannot join channel (+l)"));
+				client->sendReply(ERR_CHANNELISFULL, client->getNickname(), channelName,
+					":Cannot join channel (+l)");
 				continue;
 			}
 		}
 		channel->addMember(client);
 		if (channel->isInvited(client))
 			channel->removeInvite(client);
-		std::string joinMsg = Utils::formatMessage(
-			client->getNickname() + "!~" + client->getUsername() + "@localhost",
-			"JOIN", channelName);
+		std::string joinMsg = Utils::formatMessage(client->getSource(), "JOIN", channel->getName());
 		channel->broadcastToAll(joinMsg);
+		chargeFanout(client, channel->getMemberCount());
+		const std::string& nick = client->getNickname();
 		if (!channel->getTopic().empty())
-			client->sendMessage(Utils::formatReply(RPL_TOPIC,
-				client->getNickname(), channelName + " :" + channel->getTopic()));
+			client->sendReply(RPL_TOPIC, nick, channel->getName(), ":" + channel->getTopic());
 		else
-			client->sendMessage(Utils::formatReply(RPL_NOTOPIC,
-				client->getNickname(), channelName + " :No topic is set"));
-		std::string namesReply = Utils::formatReply(RPL_NAMREPLY,
-			client->getNickname(), "= " + channelName + " :" + channel->getMemberList());
-		client->sendMessage(namesReply);
-		client->sendMessage(Utils::formatReply(RPL_ENDOFNAMES,
-			client->getNickname(), channelName + " :End of /NAMES list"));
+			client->sendReply(RPL_NOTOPIC, nick, channel->getName(), ":No topic is set");
+		client->sendReply(RPL_NAMREPLY, nick, "= " + channel->getName(), ":" + channel->getMemberList());
+		client->sendReply(RPL_ENDOFNAMES, nick, channel->getName(), ":End of /NAMES list");
 	}
 }
 
 void Server::handlePartAll(Client* client)
 {
-	std::vector<Channel*> clientChannels;
-
-	for (size_t i = 0; i < _channels.size(); ++i)
-	{
-		if (_channels[i]->isMember(client))
-			clientChannels.push_back(_channels[i]);
-	}
-	for (size_t i = 0; i < clientChannels.size(); ++i)
+	// removeMember drops the channel from the client's own set, so this
+	// drains the set without copying it.
+	while (!client->getChannels().empty())
 	{
-		Channel* channel = clientChannels[i];
+		Channel* channel = *client->getChannels().begin();
 
-		std::string partMsg = Utils::formatMessage(
-			client->getNickname() + "!~" + client->getUsername() + "@localhost",
-			"PART", channel->getName() + " :Left all channels");
+		std::string partMsg = Utils::formatMessage(client->getSource(), "PART", channel->getName(),
+			"Left all channels");
 		channel->broadcastToAll(partMsg);
 		channel->removeMember(client);
 		if (channel->isEmpty())
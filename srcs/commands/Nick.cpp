@@ -1,41 +1,38 @@
 #include "Server.hpp"
 #include "Utils.hpp"
-#include <iostream>
+#include "Logger.hpp"
 
 void Server::handleNick(Client* client, const Command& cmd)
 {
-	std::vector<std::string> params = cmd.getParams();
-	if (params.empty())
+	if (cmd.getParamCount() == 0)
 	{
-		std::string reply = Utils::formatReply(ERR_NONICKNAMEGIVEN, "*", ":No nickname given");
-		client->sendMessage(reply);
+		client->sendReply(ERR_NONICKNAMEGIVEN, "*", ":No nickname given");
 		return;
 	}
 	
-	std::string nickname = params[0];
+	std::string nickname = cmd.getParam(0).str();
 	
 	if (nickname.empty() || nickname.length() > 9)
 	{
-		std::string reply = Utils::formatReply(ERR_ERRONEUSNICKNAME, "*", nickname + " :Erroneous nickname");
-		client->sendMessage(reply);
+		client->sendReply(ERR_ERRONEUSNICKNAME, "*", nickname, ":Erroneous nickname");
 		return;
 	}
 	
 	if (isNicknameInUse(nickname, client))
 	{
-		std::string reply = Utils::formatReply(ERR_NICKNAMEINUSE, "*", nickname + " :Nickname is already in use");
-		client->sendMessage(reply);
+		client->sendReply(ERR_NICKNAMEINUSE, "*", nickname, ":Nickname is already in use");
 		return;
 	}
 	
-	std::string oldNick = client->getNickname();
-	client->setNickname(nickname);
+	bool announce = !client->getNickname().empty() && client->isRegistered();
+	std::string oldSource = client->getSource();
+	renameClient(client, nickname);
 	
-	if (!oldNick.empty() && client->isRegistered())
+	if (announce)
 	{
-		std::string msg = Utils::formatMessage(oldNick + "!~" + client->getUsername() + "@localhost", "NICK", ":" + nickname);
+		std::string msg = Utils::formatMessage(oldSource, "NICK", ":" + nickname);
 		client->sendMessage(msg);
 	}
 	
-	std::cout << "Client " << client->getFd() << " set nickname to: " << nickname << std::endl;
+	LOG(LOG_DEBUG, LOG_CLIENT) << "Client " << client->getFd() << " set nickname to: " << nickname;
 }
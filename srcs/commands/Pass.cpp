@@ -1,32 +1,22 @@
 #include "Server.hpp"
 #include "Utils.hpp"
-#include <iostream>
+#include "Logger.hpp"
 
 void Server::handlePass(Client* client, const Command& cmd)
 {
 	if (client->isRegistered())
 	{
-		std::string reply = Utils::formatReply(ERR_ALREADYREGISTRED, client->getNickname(), ":You may not reregister");
-		client->sendMessage(reply);
+		client->sendReply(ERR_ALREADYREGISTRED, client->getNickname(), ":You may not reregister");
 		return;
 	}
 	
-	std::vector<std::string> params = cmd.getParams();
-	if (params.empty())
-	{
-		std::string reply = Utils::formatReply(ERR_NEEDMOREPARAMS, "*", "PASS :Not enough parameters");
-		client->sendMessage(reply);
-		return;
-	}
-	
-	if (params[0] == getPassword())
+	if (cmd.getParam(0) == getPassword())
 	{
 		client->setHasPassword(true);
-		std::cout << "Client " << client->getFd() << " authenticated with password" << std::endl;
+		LOG(LOG_DEBUG, LOG_CLIENT) << "Client " << client->getFd() << " authenticated with password";
 	}
 	else
 	{
-		std::string reply = Utils::formatReply(ERR_PASSWDMISMATCH, "*", ":Password incorrect");
-		client->sendMessage(reply);
+		client->sendReply(ERR_PASSWDMISMATCH, "*", ":Password incorrect");
 	}
 }
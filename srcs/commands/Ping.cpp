@@ -0,0 +1,23 @@
+#include "Server.hpp"
+#include "Utils.hpp"
+
+void Server::handlePing(Client* client, const Command& cmd)
+{
+	StringView token = cmd.getParamCount() > 0 ? cmd.getParam(0) : cmd.getTrailing();
+	if (token.empty())
+	{
+		const std::string& nick = client->getNickname();
+		client->sendReply(ERR_NOORIGIN, nick.empty() ? StringView("*") : StringView(nick), ":No origin specified");
+		return;
+	}
+	const std::string& serverName = Utils::getServerName();
+	client->sendCommand(serverName, "PONG", serverName, token);
+}
+
+// Any input already counts as activity for the liveness checks, so the
+// answer to our PING needs no handling of its own.
+void Server::handlePong(Client* client, const Command& cmd)
+{
+	(void)client;
+	(void)cmd;
+}
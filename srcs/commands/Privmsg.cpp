@@ -3,38 +3,25 @@
 #include "Channel.hpp"
 #include "Command.hpp"
 #include "Utils.hpp"
-#include <iostream>
+#include "Logger.hpp"
 
 void Server::handlePrivmsg(Client* client, const Command& cmd)
 {
-	if (!client->isRegistered())
-	{
-		std::string reply = Utils::formatReply(ERR_NOTREGISTERED, "*", ":You have not registered");
-		client->sendMessage(reply);
-		return;
-	}
-	std::vector<std::string> params = cmd.getParams();
-	if (params.empty())
+	if (cmd.getParamCount() == 0)
 	{
-		std::string reply = Utils::formatReply(ERR_NORECIPIENT, client->getNickname(), 
-		                                       ":No recipient given (PRIVMSG)");
-		client->sendMessage(reply);
+		client->sendReply(ERR_NORECIPIENT, client->getNickname(), ":No recipient given (PRIVMSG)");
 		return;
 	}
 	if (cmd.getTrailing().empty())
 	{
-		std::string reply = Utils::formatReply(ERR_NOTEXTTOSEND, client->getNickname(), 
-		                                       ":No text to send");
-		client->sendMessage(reply);
+		client->sendReply(ERR_NOTEXTTOSEND, client->getNickname(), ":No text to send");
 		return;
 	}
-	std::string message = cmd.getTrailing();
-	std::vector<std::string> targets = Utils::splitByComma(params[0]);
+	std::string message = cmd.getTrailing().str();
+	std::vector<std::string> targets = Utils::splitByComma(cmd.getParam(0));
 	if (targets.size() > 10)
 	{
-		std::string reply = Utils::formatReply(ERR_TOOMANYTARGETS, client->getNickname(), 
-		                                       params[0] + " :Too many recipients");
-		client->sendMessage(reply);
+		client->sendReply(ERR_TOOMANYTARGETS, client->getNickname(), cmd.getParam(0), ":Too many recipients");
 		return;
 	}
 	for (size_t i = 0; i < targets.size(); ++i)
@@ -59,25 +46,18 @@ void Server::handleChannelMessage(Client* client, const std::string& channelName
 	
 	if (!channel)
 	{
-		std::string reply = Utils::formatReply(ERR_NOSUCHCHANNEL, client->getNickname(), 
-		                                       channelName + " :No such channel");
-		client->sendMessage(reply);
+		client->sendReply(ERR_NOSUCHCHANNEL, client->getNickname(), channelName, ":No such channel");
 		return;
 	}
 	if (!channel->isMember(client))
 	{
-		std::string reply = Utils::formatReply(ERR_CANNOTSENDTOCHAN, client->getNickname(), 
-		                                       channelName + " :Cannot send to channel");
-		client->sendMessage(reply);
+		client->sendReply(ERR_CANNOTSENDTOCHAN, client->getNickname(), channelName, ":Cannot send to channel");
 		return;
 	}
-	std::string fullMessage = Utils::formatMessage(client->getNickname() + "!~" + 
-	                                              client->getUsername() + "@localhost", 
-	                                              "PRIVMSG", 
-	                                              channelName + " :" + message);
+	std::string fullMessage = Utils::formatMessage(client->getSource(), "PRIVMSG", channelName, message);
 	channel->broadcast(fullMessage, client);
-	std::cout << client->getNickname() << " -> " << channelName 
-	          << ": " << message << std::endl;
+	chargeFanout(client, channel->getMemberCount());
+	LOG(LOG_DEBUG, LOG_MESSAGE) << client->getNickname() << " -> " << channelName << LogBody(message);
 }
 
 void Server::handlePrivateMessage(Client* sender, const std::string& targetNick, 
@@ -87,29 +67,22 @@ void Server::handlePrivateMessage(Client* sender, const std::string& targetNick,
 	
 	if (!target)
 	{
-		std::string reply = Utils::formatReply(ERR_NOSUCHNICK, sender->getNickname(), 
-		                                       targetNick + " :No such nick/channel");
-		sender->sendMessage(reply);
+		sender->sendReply(ERR_NOSUCHNICK, sender->getNickname(), targetNick, ":No such nick/channel");
 		return;
 	}
-	std::string fullMessage = Utils::formatMessage(sender->getNickname() + "!~" + 
-	                                              sender->getUsername() + "@localhost", 
-	                                              "PRIVMSG", 
-	                                              targetNick + " :" + message);
+	std::string fullMessage = Utils::formatMessage(sender->getSource(), "PRIVMSG", targetNick, message);
 	target->sendMessage(fullMessage);
-	std::cout << sender->getNickname() << " -> " << targetNick 
-	          << " (PM): " << message << std::endl;
+	LOG(LOG_DEBUG, LOG_MESSAGE) << sender->getNickname() << " -> " << targetNick << " (PM)" << LogBody(message);
 }
 
 void Server::handleNotice(Client* client, const Command& cmd)
 {
 	if (!client->isRegistered())
 		return;
-	std::vector<std::string> params = cmd.getParams();
-	if (params.empty() || cmd.getTrailing().empty())
+	if (cmd.getParamCount() == 0 || cmd.getTrailing().empty())
 		return;
-	std::string message = cmd.getTrailing();
-	std::vector<std::string> targets = Utils::splitByComma(params[0]);
+	std::string message = cmd.getTrailing().str();
+	std::vector<std::string> targets = Utils::splitByComma(cmd.getParam(0));
 	if (targets.size() > 10)
 		return;
 	for (size_t i = 0; i < targets.size(); ++i)
@@ -121,21 +94,16 @@ void Server::handleNotice(Client* client, const Command& cmd)
 			Channel* channel = getChannel(target);
 			if (!channel || !channel->isMember(client))
 				continue;
-			std::string fullMessage = Utils::formatMessage(client->getNickname() + "!~" + 
-			                                              client->getUsername() + "@localhost", 
-			                                              "NOTICE", 
-			                                              target + " :" + message);
+			std::string fullMessage = Utils::formatMessage(client->getSource(), "NOTICE", target, message);
 			channel->broadcast(fullMessage, client);
+			chargeFanout(client, channel->getMemberCount());
 		}
 		else
 		{
 			Client* targetClient = getClientByNickname(target);
 			if (!targetClient)
 				continue;
-			std::string fullMessage = Utils::formatMessage(client->getNickname() + "!~" + 
-			                                              client->getUsername() + "@localhost", 
-			                                              "NOTICE", 
-			                                              target + " :" + message);
+			std::string fullMessage = Utils::formatMessage(client->getSource(), "NOTICE", target, message);
 			targetClient->sendMessage(fullMessage);
 		}
 	}
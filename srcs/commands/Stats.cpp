@@ -0,0 +1,130 @@
+#include "Server.hpp"
+#include "Utils.hpp"
+#include "Pool.hpp"
+#include <cstdarg>
+#include <cstdio>
+
+static void sendStatsLine(Client* client, int code, const char* format, ...) __attribute__((format(printf, 3, 4)));
+
+static void sendStatsLine(Client* client, int code, const char* format, ...)
+{
+	char buffer[256];
+	va_list args;
+
+	va_start(args, format);
+	std::vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	client->sendReply(code, client->getNickname(), buffer);
+}
+
+// STATS <letter>:
+//   m  per-command counts and bytes (RFC 2812 212)
+//   u  uptime
+//   t  server counters and gauges
+//   h  per-command latency percentiles, in nanoseconds
+//   z  object pools
+// Anything else just gets the end-of-report line. There are no IRC
+// operators, so t, h and z, which show other users' disconnect reasons and
+// the server's internals, are refused with ERR_NOPRIVILEGES unless
+// IRCSERV_STATS_PUBLIC is set; the metrics endpoint has the same figures.
+void Server::handleStats(Client* client, const Command& cmd)
+{
+	std::string query = cmd.getParamCount() > 0 ? cmd.getParam(0).str() : std::string();
+	char letter = query.empty() ? '*' : query[0];
+
+	if ((letter == 't' || letter == 'h' || letter == 'z') && !_config.statsPublic)
+	{
+		client->sendReply(ERR_NOPRIVILEGES, client->getNickname(), ":Permission Denied- You're not an IRC operator");
+		return;
+	}
+	if (letter == 'm')
+	{
+		for (int id = 0; id < CMD_COUNT; id++)
+		{
+			const CommandMetrics& command = _metrics.commands[id];
+			if (command.latency.getCount() == 0)
+				continue;
+			sendStatsLine(client, RPL_STATSCOMMANDS, "%s %lu %lu 0", Command::lookup(static_cast<CommandId>(id))->name,
+				command.latency.getCount(), command.bytes);
+		}
+	}
+	else if (letter == 'u')
+	{
+		unsigned long seconds = (_now - _metrics.startedMs) / 1000;
+		sendStatsLine(client, RPL_STATSUPTIME, ":Server Up %lu days %lu:%02lu:%02lu", seconds / 86400,
+			seconds / 3600 % 24, seconds / 60 % 60, seconds % 60);
+	}
+	else if (letter == 't')
+	{
+		MetricsGauges gauges;
+		collectGauges(gauges);
+		sendStatsLine(client, RPL_STATSDEBUG, ":accepted %lu clients %lu registered %lu channels %lu",
+			_metrics.connectionsAccepted, static_cast<unsigned long>(gauges.clients),
+			static_cast<unsigned long>(gauges.registered), static_cast<unsigned long>(gauges.channels));
+		sendStatsLine(client, RPL_STATSDEBUG, ":received %lu bytes %lu lines %lu unknown",
+			_metrics.bytesReceived, _metrics.linesReceived, _metrics.unknownCommands);
+		sendStatsLine(client, RPL_STATSDEBUG, ":sent %lu bytes %lu lines %lu writes",
+			_metrics.send.bytesSent, _metrics.send.linesSent, _metrics.send.writeCalls);
+		sendStatsLine(client, RPL_STATSDEBUG, ":sendq %lu bytes %lu max throttled %lu (%lu total) timers %lu",
+			static_cast<unsigned long>(gauges.sendQueueBytes), static_cast<unsigned long>(gauges.maxSendQueueBytes),
+			static_cast<unsigned long>(gauges.throttled), _metrics.throttles, static_cast<unsigned long>(gauges.timers));
+		for (std::map<std::string, unsigned long>::const_iterator it = _metrics.disconnects.begin();
+			it != _metrics.disconnects.end(); ++it)
+			sendStatsLine(client, RPL_STATSDEBUG, ":disconnects %lu %s", it->second, it->first.c_str());
+	}
+	else if (letter == 'h')
+	{
+		for (int id = 0; id < CMD_COUNT; id++)
+		{
+			const LatencyHistogram& latency = _metrics.commands[id].latency;
+			if (latency.getCount() == 0)
+				continue;
+			sendStatsLine(client, RPL_STATSDEBUG, ":%s count %lu p50 %llu p99 %llu max %llu",
+				Command::lookup(static_cast<CommandId>(id))->name, latency.getCount(),
+				latency.percentileNs(0.5), latency.percentileNs(0.99), latency.getMaxNs());
+		}
+	}
+	else if (letter == 'z')
+	{
+		std::vector<PoolStats> pools;
+		ObjectPool::collectStats(pools);
+		for (size_t i = 0; i < pools.size(); i++)
+		{
+			sendStatsLine(client, RPL_STATSDEBUG, ":pool %s in use %lu free %lu high water %lu reserved %lu",
+				pools[i].name, static_cast<unsigned long>(pools[i].inUse), static_cast<unsigned long>(pools[i].free),
+				static_cast<unsigned long>(pools[i].highWater), static_cast<unsigned long>(pools[i].bytesReserved));
+		}
+	}
+	client->sendReply(RPL_ENDOFSTATS, client->getNickname(), StringView(&letter, 1), ":End of STATS report");
+}
+
+void Server::collectGauges(MetricsGauges& gauges) const
+{
+	for (size_t fd = 0; fd < _clients.size(); fd++)
+	{
+		const Client* client = _clients[fd];
+		if (!client)
+			continue;
+		++gauges.clients;
+		if (client->isRegistered())
+			++gauges.registered;
+		size_t queued = client->getSendQueueSize();
+		gauges.sendQueueBytes += queued;
+		if (queued > gauges.maxSendQueueBytes)
+			gauges.maxSendQueueBytes = queued;
+	}
+	gauges.channels = _channels.size();
+	gauges.throttled = _throttledClients.size();
+	gauges.timers = _timers.size();
+}
+
+// Called by the metrics exporter when a scrape comes in.
+void Server::renderMetrics(std::string& body)
+{
+	MetricsGauges gauges;
+	std::vector<PoolStats> pools;
+
+	collectGauges(gauges);
+	ObjectPool::collectStats(pools);
+	_metrics.renderPrometheus(body, _now, gauges, pools);
+}
@@ -1,59 +1,49 @@
 #include "Server.hpp"
 #include "Utils.hpp"
-#include <iostream>
+#include "Logger.hpp"
 
 void Server::handleUser(Client* client, const Command& cmd)
 {
 	if (client->isRegistered())
 	{
-		std::string reply = Utils::formatReply(ERR_ALREADYREGISTRED, client->getNickname(), ":You may not reregister");
-		client->sendMessage(reply);
+		client->sendReply(ERR_ALREADYREGISTRED, client->getNickname(), ":You may not reregister");
 		return;
 	}
 	
-	std::vector<std::string> params = cmd.getParams();
-	if (params.size() < 3 || cmd.getTrailing().empty())
+	if (cmd.getTrailing().empty())
 	{
-		std::string reply = Utils::formatReply(ERR_NEEDMOREPARAMS, "*", "USER :Not enough parameters");
-		client->sendMessage(reply);
+		client->sendReply(ERR_NEEDMOREPARAMS, "*", "USER", ":Not enough parameters");
 		return;
 	}
 	
 	if (!client->hasPassword())
 	{
-		std::string reply = Utils::formatReply(ERR_PASSWDMISMATCH, "*", ":Password required");
-		client->sendMessage(reply);
+		client->sendReply(ERR_PASSWDMISMATCH, "*", ":Password required");
 		return;
 	}
 	
 	if (client->getNickname().empty())
 	{
-		std::string reply = Utils::formatReply(ERR_NOTREGISTERED, "*", ":You must set a nickname first");
-		client->sendMessage(reply);
+		client->sendReply(ERR_NOTREGISTERED, "*", ":You must set a nickname first");
 		return;
 	}
 	
-	client->setUsername(params[0]);
+	client->setUsername(cmd.getParam(0).str());
 	client->setRegistered(true);
+	schedulePing(client);
 	
-	std::cout << "Client " << client->getFd() << " registered as " << client->getNickname() << std::endl;
+	LOG(LOG_INFO, LOG_CLIENT) << "Client " << client->getFd() << " registered as " << client->getSource();
 	
 	sendWelcome(client);
 }
 
 void Server::sendWelcome(Client* client)
 {
-	std::string nick = client->getNickname();
+	const std::string& nick = client->getNickname();
+	const std::string& serverName = Utils::getServerName();
 	
-	std::string welcome = Utils::formatReply(RPL_WELCOME, nick, ":Welcome to the IRC Network " + nick + "!~" + client->getUsername() + "@localhost");
-	client->sendMessage(welcome);
-	
-	std::string yourhost = Utils::formatReply(RPL_YOURHOST, nick, ":Your host is server, running version 1.0");
-	client->sendMessage(yourhost);
-	
-	std::string created = Utils::formatReply(RPL_CREATED, nick, ":This server was created sometime");
-	client->sendMessage(created);
-	
-	std::string myinfo = Utils::formatReply(RPL_MYINFO, nick, "server 1.0 o o");
-	client->sendMessage(myinfo);
+	client->sendReply(RPL_WELCOME, nick, ":Welcome to the IRC Network " + client->getSource());
+	client->sendReply(RPL_YOURHOST, nick, ":Your host is " + serverName + ", running version 1.0");
+	client->sendReply(RPL_CREATED, nick, ":This server was created sometime");
+	client->sendReply(RPL_MYINFO, nick, serverName, "1.0 o o");
 }
@@ -1,6 +1,14 @@
 #include "Server.hpp"
+#include "Logger.hpp"
 #include <iostream>
 #include <cstdlib>
+#include <csignal>
+
+static void onShutdownSignal(int signum)
+{
+	(void)signum;
+	Server::requestShutdown();
+}
 
 int main(int argc, char** argv)
 {
@@ -21,15 +29,23 @@ int main(int argc, char** argv)
 		std::cerr << "Error: Password cannot be empty" << std::endl;
 		return 1;
 	}
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, onShutdownSignal);
+	signal(SIGTERM, onShutdownSignal);
+	ServerConfig config;
+	config.loadEnvironment();
+	Logger::open(2, config.logLevel, config.logCategories, config.logBodies);
 	try
 	{
-		Server server(port, password);
+		Server server(port, password, config);
 		server.run();
 	}
 	catch (const std::exception& e)
 	{
+		Logger::close();
 		std::cerr << "Error: " << e.what() << std::endl;
 		return 1;
 	}
+	Logger::close();
 	return 0;
 }
@@ -0,0 +1,86 @@
+#include "EpollReactor.hpp"
+
+#ifdef __linux__
+
+#include <unistd.h>
+
+EpollReactor::EpollReactor() : _epollFd(epoll_create1(EPOLL_CLOEXEC)), _ready(256)
+{
+}
+
+EpollReactor::~EpollReactor()
+{
+	if (_epollFd >= 0)
+		close(_epollFd);
+}
+
+bool EpollReactor::isOpen() const
+{
+	return _epollFd >= 0;
+}
+
+bool EpollReactor::control(int op, int fd, int events)
+{
+	struct epoll_event ev;
+	ev.events = EPOLLET | EPOLLRDHUP;
+	if (events & READ)
+		ev.events |= EPOLLIN;
+	if (events & WRITE)
+		ev.events |= EPOLLOUT;
+	ev.data.u64 = 0;
+	ev.data.fd = fd;
+	return epoll_ctl(_epollFd, op, fd, &ev) == 0;
+}
+
+bool EpollReactor::add(int fd, int events)
+{
+	return control(EPOLL_CTL_ADD, fd, events);
+}
+
+bool EpollReactor::modify(int fd, int events)
+{
+	return control(EPOLL_CTL_MOD, fd, events);
+}
+
+void EpollReactor::remove(int fd)
+{
+	struct epoll_event ev;
+	ev.events = 0;
+	ev.data.u64 = 0;
+	epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, &ev);
+}
+
+int EpollReactor::wait(std::vector<Event>& events, int timeoutMs)
+{
+	events.clear();
+
+	int count = epoll_wait(_epollFd, &_ready[0], _ready.size(), timeoutMs);
+	if (count <= 0)
+		return count;
+
+	for (int i = 0; i < count; i++)
+	{
+		Event event;
+		event.fd = _ready[i].data.fd;
+		event.events = 0;
+		event.result = 0;
+		event.data = NULL;
+		if (_ready[i].events & EPOLLIN)
+			event.events |= READ;
+		if (_ready[i].events & EPOLLOUT)
+			event.events |= WRITE;
+		if (_ready[i].events & (EPOLLHUP | EPOLLERR | EPOLLRDHUP))
+			event.events |= HANGUP;
+		events.push_back(event);
+	}
+	if (static_cast<size_t>(count) == _ready.size())
+		_ready.resize(_ready.size() * 2);
+	return count;
+}
+
+const char* EpollReactor::getName() const
+{
+	return "epoll";
+}
+
+#endif
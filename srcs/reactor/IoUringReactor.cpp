@@ -0,0 +1,681 @@
+#include "IoUringReactor.hpp"
+
+#ifdef __linux__
+
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/time_types.h>
+
+static const unsigned kRingEntries = 1024;
+
+// Provided receive buffers: kBufferCount of kBufferSize bytes in one group,
+// handed back to the kernel on the wait() after they were reported.
+static const unsigned kBufferCount = 1024;
+static const size_t kBufferSize = 4096;
+static const unsigned short kBufferGroup = 0;
+
+// A finished send keeps its copy buffer for the next one unless it grew
+// past this.
+static const size_t kSendKeep = 16384;
+
+// Longest wait() sleeps while requests that found no free SQE are queued.
+static const int kRetryMs = 1;
+
+// user_data of cancel requests, whose completions carry nothing.
+static const unsigned long long kIgnore = ~0ULL;
+
+// io_uring_setup() features this backend relies on. RSRC_TAGS only serves
+// as the marker for 5.13, the release that added multishot poll.
+static const unsigned kRequiredFeatures = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP
+	| IORING_FEAT_EXT_ARG | IORING_FEAT_RSRC_TAGS;
+
+static unsigned loadAcquire(const unsigned* p)
+{
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static void storeRelease(unsigned* p, unsigned value)
+{
+	__atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+// A request is named by its op, the fd, and the generation and sequence of
+// the fd's slot, so completions can be matched against what the slot holds
+// now. A send is named by its index in _sends instead of the fd. Both
+// counters are truncated; they only need to tell apart the requests whose
+// completions can still be in flight.
+static unsigned long long requestId(unsigned op, unsigned fd, unsigned generation, unsigned sequence)
+{
+	return (static_cast<unsigned long long>(op) << 56)
+		| (static_cast<unsigned long long>(sequence & 0xff) << 48)
+		| (static_cast<unsigned long long>(generation & 0xffff) << 32) | fd;
+}
+
+static unsigned requestOp(unsigned long long request)
+{
+	return static_cast<unsigned>(request >> 56);
+}
+
+static int requestFd(unsigned long long request)
+{
+	return static_cast<int>(request & 0xffffffffULL);
+}
+
+static void pushEvent(std::vector<Reactor::Event>& events, int fd, int kind, int result, const char* data)
+{
+	Reactor::Event event;
+	event.fd = fd;
+	event.events = kind;
+	event.result = result;
+	event.data = data;
+	events.push_back(event);
+}
+
+IoUringReactor::Slot::Slot() : events(0), generation(0), sequence(0), op(OP_POLL), send(-1), active(false)
+{
+}
+
+IoUringReactor::IoUringReactor()
+	: _ringFd(-1), _ringMemory(MAP_FAILED), _ringSize(0), _sqes(NULL), _sqesSize(0),
+	  _sqFlags(NULL), _sqArray(NULL), _cqes(NULL), _completions(false), _bufferMemory(MAP_FAILED),
+	  _bufferMemorySize(0), _bufferRing(NULL), _buffers(NULL), _bufferTail(0)
+{
+	std::memset(&_sq, 0, sizeof(_sq));
+	std::memset(&_cq, 0, sizeof(_cq));
+	if (!setup(kRingEntries) && _ringFd >= 0)
+	{
+		close(_ringFd);
+		_ringFd = -1;
+	}
+	if (_ringFd >= 0)
+		_completions = setupCompletions();
+}
+
+// Closing the ring first ends the requests that still point into the
+// receive buffers and the send copies.
+IoUringReactor::~IoUringReactor()
+{
+	if (_ringFd >= 0)
+		close(_ringFd);
+	if (_sqes)
+		munmap(_sqes, _sqesSize);
+	if (_ringMemory != MAP_FAILED)
+		munmap(_ringMemory, _ringSize);
+	if (_bufferMemory != MAP_FAILED)
+		munmap(_bufferMemory, _bufferMemorySize);
+	for (size_t i = 0; i < _sends.size(); ++i)
+		delete _sends[i];
+}
+
+bool IoUringReactor::setup(unsigned entries)
+{
+	struct io_uring_params params;
+	std::memset(&params, 0, sizeof(params));
+
+	_ringFd = syscall(__NR_io_uring_setup, entries, &params);
+	if (_ringFd < 0 || (params.features & kRequiredFeatures) != kRequiredFeatures)
+		return false;
+
+	size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	_ringSize = sqSize > cqSize ? sqSize : cqSize;
+	_ringMemory = mmap(NULL, _ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		_ringFd, IORING_OFF_SQ_RING);
+	if (_ringMemory == MAP_FAILED)
+		return false;
+
+	_sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	void* sqes = mmap(NULL, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		_ringFd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED)
+		return false;
+	_sqes = static_cast<struct io_uring_sqe*>(sqes);
+
+	char* base = static_cast<char*>(_ringMemory);
+	_sq.head = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+	_sq.tail = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+	_sq.mask = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+	_sq.entries = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_entries);
+	_sqFlags = reinterpret_cast<unsigned*>(base + params.sq_off.flags);
+	_sqArray = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+	_cq.head = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+	_cq.tail = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+	_cq.mask = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+	_cq.entries = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_entries);
+	_cqes = reinterpret_cast<struct io_uring_cqe*>(base + params.cq_off.cqes);
+
+	// SQE slot i always sits at ring position i, so the index array is
+	// filled once here and submitting is just a tail bump.
+	for (unsigned i = 0; i < _sq.entries; ++i)
+		_sqArray[i] = i;
+	return true;
+}
+
+// Completion I/O needs multishot accept and recv, cancel by user_data and a
+// provided-buffer ring. Support for SEND_ZC only serves as the marker for
+// 6.0, the release that added multishot recv. Without them the ring still
+// reports readiness.
+bool IoUringReactor::setupCompletions()
+{
+	static const unsigned required[] = { IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SEND,
+		IORING_OP_ASYNC_CANCEL, IORING_OP_SEND_ZC };
+	std::vector<char> probeMemory(sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op), 0);
+	struct io_uring_probe* probe = reinterpret_cast<struct io_uring_probe*>(&probeMemory[0]);
+
+	if (syscall(__NR_io_uring_register, _ringFd, IORING_REGISTER_PROBE, probe, 256) < 0)
+		return false;
+	for (size_t i = 0; i < sizeof(required) / sizeof(required[0]); ++i)
+	{
+		if (required[i] > probe->last_op || !(probe->ops[required[i]].flags & IO_URING_OP_SUPPORTED))
+			return false;
+	}
+
+	size_t ringBytes = kBufferCount * sizeof(struct io_uring_buf);
+	_bufferMemorySize = ringBytes + kBufferCount * kBufferSize;
+	_bufferMemory = mmap(NULL, _bufferMemorySize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (_bufferMemory == MAP_FAILED)
+		return false;
+	_bufferRing = static_cast<struct io_uring_buf*>(_bufferMemory);
+	_buffers = static_cast<char*>(_bufferMemory) + ringBytes;
+
+	struct io_uring_buf_reg reg;
+	std::memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = reinterpret_cast<unsigned long>(_bufferMemory);
+	reg.ring_entries = kBufferCount;
+	reg.bgid = kBufferGroup;
+	if (syscall(__NR_io_uring_register, _ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+		return false;
+
+	for (unsigned i = 0; i < kBufferCount; ++i)
+		_usedBuffers.push_back(i);
+	recycleBuffers();
+	return true;
+}
+
+bool IoUringReactor::isOpen() const
+{
+	return _ringFd >= 0;
+}
+
+bool IoUringReactor::hasCompletions() const
+{
+	return _completions;
+}
+
+// Returns a zeroed SQE at the ring tail, handing the queued ones to the
+// kernel first if the ring is full.
+struct io_uring_sqe* IoUringReactor::nextSqe()
+{
+	unsigned tail = *_sq.tail;
+
+	if (tail - loadAcquire(_sq.head) >= _sq.entries)
+	{
+		enter(0, 0);
+		if (tail - loadAcquire(_sq.head) >= _sq.entries)
+			return NULL;
+	}
+	struct io_uring_sqe* sqe = &_sqes[tail & _sq.mask];
+	std::memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+
+// Makes sure count SQEs are free, handing the queued ones to the kernel if
+// not, so a change needing several requests is queued whole or not at all.
+bool IoUringReactor::reserve(unsigned count)
+{
+	if (*_sq.tail - loadAcquire(_sq.head) + count <= _sq.entries)
+		return true;
+	enter(0, 0);
+	return *_sq.tail - loadAcquire(_sq.head) + count <= _sq.entries;
+}
+
+// Submits everything queued and, when minComplete is non-zero, waits for
+// that many completions or timeoutMs (negative = no limit).
+int IoUringReactor::enter(unsigned minComplete, int timeoutMs)
+{
+	unsigned toSubmit = *_sq.tail - loadAcquire(_sq.head);
+	unsigned flags = 0;
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	void* argp = NULL;
+	size_t argSize = 0;
+
+	if (minComplete > 0 || (loadAcquire(_sqFlags) & IORING_SQ_CQ_OVERFLOW))
+		flags |= IORING_ENTER_GETEVENTS;
+	else if (toSubmit == 0)
+		return 0;
+	if (minComplete > 0 && timeoutMs >= 0)
+	{
+		ts.tv_sec = timeoutMs / 1000;
+		ts.tv_nsec = (timeoutMs % 1000) * 1000000LL;
+		std::memset(&arg, 0, sizeof(arg));
+		arg.ts = reinterpret_cast<unsigned long long>(&ts);
+		flags |= IORING_ENTER_EXT_ARG;
+		argp = &arg;
+		argSize = sizeof(arg);
+	}
+	return syscall(__NR_io_uring_enter, _ringFd, toSubmit, minComplete, flags, argp, argSize);
+}
+
+// A poll slot always has a request, if only for hangups; an accept or
+// receive slot has none while it is switched off.
+bool IoUringReactor::hasRequest(const Slot& slot) const
+{
+	return slot.op == OP_POLL || slot.events != 0;
+}
+
+unsigned long long IoUringReactor::currentRequest(int fd) const
+{
+	const Slot& slot = _slots[fd];
+	return requestId(slot.op, fd, slot.generation, slot.sequence);
+}
+
+// Whether a request's fd is still the connection it was made for.
+bool IoUringReactor::isLive(unsigned long long request) const
+{
+	int fd = requestFd(request);
+	return static_cast<size_t>(fd) < _slots.size() && _slots[fd].active
+		&& ((request >> 32) & 0xffff) == (_slots[fd].generation & 0xffff);
+}
+
+// Whether it is, moreover, the request the fd holds now.
+bool IoUringReactor::isCurrent(unsigned long long request) const
+{
+	return isLive(request) && request == currentRequest(requestFd(request));
+}
+
+bool IoUringReactor::arm(int fd)
+{
+	struct io_uring_sqe* sqe = nextSqe();
+	if (!sqe)
+		return false;
+
+	const Slot& slot = _slots[fd];
+	sqe->fd = fd;
+	sqe->user_data = currentRequest(fd);
+	if (slot.op == OP_ACCEPT)
+	{
+		// Blocking sockets: the ring does all their I/O and never waits.
+		sqe->opcode = IORING_OP_ACCEPT;
+		sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+		sqe->accept_flags = SOCK_CLOEXEC;
+	}
+	else if (slot.op == OP_RECEIVE)
+	{
+		sqe->opcode = IORING_OP_RECV;
+		sqe->ioprio = IORING_RECV_MULTISHOT;
+		sqe->flags = IOSQE_BUFFER_SELECT;
+		sqe->buf_group = kBufferGroup;
+	}
+	else
+	{
+		unsigned mask = POLLRDHUP;
+		if (slot.events & READ)
+			mask |= POLLIN;
+		if (slot.events & WRITE)
+			mask |= POLLOUT;
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->poll32_events = mask;
+		sqe->len = IORING_POLL_ADD_MULTI;
+	}
+	storeRelease(_sq.tail, *_sq.tail + 1);
+	return true;
+}
+
+// Arms a fresh request for the fd whose multishot request just ended, or
+// leaves that to the next wait() if the ring is full.
+void IoUringReactor::rearm(unsigned long long request)
+{
+	if (!arm(requestFd(request)))
+		_pendingArms.push_back(request);
+}
+
+bool IoUringReactor::disarm(unsigned long long request)
+{
+	struct io_uring_sqe* sqe = nextSqe();
+	if (!sqe)
+		return false;
+
+	sqe->opcode = requestOp(request) == OP_POLL ? IORING_OP_POLL_REMOVE : IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = request;
+	sqe->user_data = kIgnore;
+	storeRelease(_sq.tail, *_sq.tail + 1);
+	return true;
+}
+
+bool IoUringReactor::submitSend(unsigned index)
+{
+	struct io_uring_sqe* sqe = nextSqe();
+	if (!sqe)
+		return false;
+
+	Send& request = *_sends[index];
+	sqe->opcode = IORING_OP_SEND;
+	sqe->fd = request.fd;
+	sqe->addr = reinterpret_cast<unsigned long>(&request.bytes[0]);
+	sqe->len = request.bytes.size();
+	sqe->msg_flags = MSG_NOSIGNAL;
+	sqe->user_data = requestId(OP_SEND, index, 0, 0);
+	storeRelease(_sq.tail, *_sq.tail + 1);
+	request.submitted = true;
+	return true;
+}
+
+void IoUringReactor::releaseSend(unsigned index)
+{
+	Send& request = *_sends[index];
+	if (request.bytes.capacity() > kSendKeep)
+		std::vector<char>().swap(request.bytes);
+	_freeSends.push_back(index);
+}
+
+// Hands the buffers whose bytes the previous wait() reported back to the
+// kernel; by now the caller has copied out what it needed.
+void IoUringReactor::recycleBuffers()
+{
+	if (_usedBuffers.empty())
+		return;
+
+	for (size_t i = 0; i < _usedBuffers.size(); ++i)
+	{
+		unsigned short id = _usedBuffers[i];
+		struct io_uring_buf& buffer = _bufferRing[_bufferTail & (kBufferCount - 1)];
+		buffer.addr = reinterpret_cast<unsigned long>(_buffers + id * kBufferSize);
+		buffer.len = kBufferSize;
+		buffer.bid = id;
+		++_bufferTail;
+	}
+	// The ring tail overlays the first entry's reserved field.
+	__atomic_store_n(&_bufferRing[0].resv, _bufferTail, __ATOMIC_RELEASE);
+	_usedBuffers.clear();
+}
+
+// Queues the removals, sends and re-arms that found the ring full last
+// time. A request holds a reference to its file, so a lost removal would
+// keep a closed socket open. A send or re-arm whose fd has moved on since
+// is dropped.
+void IoUringReactor::retryPending()
+{
+	size_t kept = 0;
+	for (size_t i = 0; i < _pendingRemoves.size(); i++)
+	{
+		if (!disarm(_pendingRemoves[i]))
+			_pendingRemoves[kept++] = _pendingRemoves[i];
+	}
+	_pendingRemoves.resize(kept);
+
+	kept = 0;
+	for (size_t i = 0; i < _pendingSends.size(); i++)
+	{
+		unsigned index = _pendingSends[i];
+		const Slot& slot = _slots[_sends[index]->fd];
+		if (!slot.active || slot.generation != _sends[index]->generation)
+			releaseSend(index);
+		else if (!submitSend(index))
+			_pendingSends[kept++] = index;
+	}
+	_pendingSends.resize(kept);
+
+	kept = 0;
+	for (size_t i = 0; i < _pendingArms.size(); i++)
+	{
+		if (isCurrent(_pendingArms[i]) && !arm(requestFd(_pendingArms[i])))
+			_pendingArms[kept++] = _pendingArms[i];
+	}
+	_pendingArms.resize(kept);
+}
+
+bool IoUringReactor::add(int fd, int events)
+{
+	if (fd < 0 || ((events & (ACCEPT | RECEIVE)) && !_completions))
+		return false;
+	if (static_cast<size_t>(fd) >= _slots.size())
+		_slots.resize(fd + 1);
+
+	Slot& slot = _slots[fd];
+	if (slot.active)
+		return false;
+	slot.events = events;
+	slot.op = (events & ACCEPT) ? OP_ACCEPT : (events & RECEIVE) ? OP_RECEIVE : OP_POLL;
+	slot.send = -1;
+	++slot.generation;
+	if (!arm(fd))
+		return false;
+	slot.active = true;
+	return true;
+}
+
+// An accept or receive fd can only be switched off (0) and on again.
+bool IoUringReactor::modify(int fd, int events)
+{
+	if (fd < 0 || static_cast<size_t>(fd) >= _slots.size() || !_slots[fd].active)
+		return false;
+
+	Slot& slot = _slots[fd];
+	if (slot.events == events)
+		return true;
+	if (slot.op != OP_POLL && events != 0 && events != (slot.op == OP_ACCEPT ? ACCEPT : RECEIVE))
+		return false;
+	if (!reserve(2))
+		return false;
+	if (hasRequest(slot))
+		disarm(currentRequest(fd));
+	slot.events = events;
+	++slot.sequence;
+	if (hasRequest(slot))
+		arm(fd);
+	return true;
+}
+
+// The caller closes the fd next, and the kernel may hand the number to the
+// next connection, so whatever is queued for an accept or receive fd is
+// submitted before this returns: a recv or send queued for this connection
+// must not reach the next one. The cancels go by user_data and are safe to
+// retry later; an unsubmitted send is dropped by retryPending().
+void IoUringReactor::remove(int fd)
+{
+	if (fd < 0 || static_cast<size_t>(fd) >= _slots.size() || !_slots[fd].active)
+		return;
+
+	Slot& slot = _slots[fd];
+	if (hasRequest(slot))
+	{
+		unsigned long long request = currentRequest(fd);
+		if (!disarm(request))
+			_pendingRemoves.push_back(request);
+	}
+	if (slot.send >= 0 && _sends[slot.send]->submitted)
+	{
+		unsigned long long request = requestId(OP_SEND, slot.send, 0, 0);
+		if (!disarm(request))
+			_pendingRemoves.push_back(request);
+	}
+	slot.send = -1;
+	slot.active = false;
+	++slot.generation;
+	if (slot.op != OP_POLL && *_sq.tail != loadAcquire(_sq.head))
+		enter(0, 0);
+}
+
+// Copies the bytes, so the caller may change or free its buffers at once.
+// One send per fd at a time; its SEND event says how much went out.
+bool IoUringReactor::send(int fd, const struct iovec* iov, size_t count)
+{
+	if (!_completions || fd < 0 || static_cast<size_t>(fd) >= _slots.size()
+		|| !_slots[fd].active || _slots[fd].send >= 0 || count == 0)
+		return false;
+
+	unsigned index;
+	if (_freeSends.empty())
+	{
+		index = _sends.size();
+		_sends.push_back(new Send());
+	}
+	else
+	{
+		index = _freeSends.back();
+		_freeSends.pop_back();
+	}
+	Send& request = *_sends[index];
+	request.fd = fd;
+	request.generation = _slots[fd].generation;
+	request.submitted = false;
+	request.bytes.clear();
+	for (size_t i = 0; i < count; ++i)
+	{
+		const char* base = static_cast<const char*>(iov[i].iov_base);
+		request.bytes.insert(request.bytes.end(), base, base + iov[i].iov_len);
+	}
+	_slots[fd].send = index;
+	if (!submitSend(index))
+		_pendingSends.push_back(index);
+	return true;
+}
+
+int IoUringReactor::wait(std::vector<Event>& events, int timeoutMs)
+{
+	events.clear();
+
+	recycleBuffers();
+	if (!_pendingRemoves.empty() || !_pendingSends.empty() || !_pendingArms.empty())
+	{
+		retryPending();
+		if ((!_pendingRemoves.empty() || !_pendingSends.empty() || !_pendingArms.empty())
+			&& (timeoutMs < 0 || timeoutMs > kRetryMs))
+			timeoutMs = kRetryMs;
+	}
+	if (enter(timeoutMs == 0 ? 0 : 1, timeoutMs) < 0 && errno != ETIME && errno != EBUSY)
+		return -1;
+
+	unsigned head = *_cq.head;
+	unsigned tail = loadAcquire(_cq.tail);
+	for (; head != tail; ++head)
+	{
+		const struct io_uring_cqe& cqe = _cqes[head & _cq.mask];
+		if (cqe.user_data == kIgnore)
+			continue;
+
+		switch (requestOp(cqe.user_data))
+		{
+			case OP_ACCEPT:
+				completeAccept(cqe, events);
+				break;
+			case OP_RECEIVE:
+				completeReceive(cqe, events);
+				break;
+			case OP_SEND:
+				completeSend(cqe, events);
+				break;
+			default:
+				completePoll(cqe, events);
+				break;
+		}
+	}
+	storeRelease(_cq.head, head);
+	return events.size();
+}
+
+void IoUringReactor::completePoll(const struct io_uring_cqe& cqe, std::vector<Event>& events)
+{
+	if (!isCurrent(cqe.user_data))
+		return;
+
+	int fd = requestFd(cqe.user_data);
+	int ready = 0;
+	// A failed request (-EINTR, -ENOMEM, a cancel that raced a modify)
+	// says nothing about the socket: report what the owner is waiting
+	// for, so its own read, write or accept finds out.
+	if (cqe.res < 0)
+		ready = _slots[fd].events;
+	else
+	{
+		if (cqe.res & POLLIN)
+			ready |= READ;
+		if (cqe.res & POLLOUT)
+			ready |= WRITE;
+		if (cqe.res & (POLLHUP | POLLERR | POLLRDHUP))
+			ready |= HANGUP;
+	}
+	// This is the fd's current request, so anything the kernel ended (an
+	// error, CQ overflow) gets a fresh one; removed or replaced requests
+	// were filtered out above.
+	if (!(cqe.flags & IORING_CQE_F_MORE))
+		rearm(cqe.user_data);
+	if (ready)
+		pushEvent(events, fd, ready, 0, NULL);
+}
+
+// An accepted fd is handed over even if accepting was switched off since,
+// as the connection exists either way; it is closed only if the listener
+// is gone. An error ends the multishot request: the caller hears of it and
+// may switch accepting off, and a fresh request is armed meanwhile.
+void IoUringReactor::completeAccept(const struct io_uring_cqe& cqe, std::vector<Event>& events)
+{
+	bool current = isCurrent(cqe.user_data);
+
+	if (cqe.res >= 0 && !isLive(cqe.user_data))
+		close(cqe.res);
+	else if (cqe.res >= 0 || current)
+		pushEvent(events, requestFd(cqe.user_data), ACCEPT, cqe.res, NULL);
+	if (current && !(cqe.flags & IORING_CQE_F_MORE))
+		rearm(cqe.user_data);
+}
+
+// Bytes are reported even from a request switched off since, as they have
+// left the socket; only a closed connection's are dropped. End of stream
+// and errors end the request and are the caller's to act on. Running out
+// of buffers ends it too; it is re-armed on the next wait(), once the
+// buffers reported this time are back in the ring.
+void IoUringReactor::completeReceive(const struct io_uring_cqe& cqe, std::vector<Event>& events)
+{
+	const char* data = NULL;
+	if (cqe.flags & IORING_CQE_F_BUFFER)
+	{
+		unsigned short id = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+		data = _buffers + id * kBufferSize;
+		_usedBuffers.push_back(id);
+	}
+
+	bool current = isCurrent(cqe.user_data);
+	int fd = requestFd(cqe.user_data);
+	if (cqe.res > 0 && isLive(cqe.user_data))
+		pushEvent(events, fd, RECEIVE, cqe.res, data);
+	else if (current && cqe.res != -ENOBUFS)
+		pushEvent(events, fd, RECEIVE, cqe.res, NULL);
+
+	if (!current || (cqe.flags & IORING_CQE_F_MORE))
+		return;
+	if (cqe.res == -ENOBUFS)
+		_pendingArms.push_back(cqe.user_data);
+	else if (cqe.res > 0)
+		rearm(cqe.user_data);
+}
+
+// Reports a send to its fd unless the connection was removed since, and
+// frees the copy either way.
+void IoUringReactor::completeSend(const struct io_uring_cqe& cqe, std::vector<Event>& events)
+{
+	unsigned index = static_cast<unsigned>(requestFd(cqe.user_data));
+	const Send& request = *_sends[index];
+	Slot& slot = _slots[request.fd];
+
+	if (slot.active && slot.generation == request.generation && slot.send == static_cast<int>(index))
+	{
+		slot.send = -1;
+		pushEvent(events, request.fd, SEND, cqe.res, NULL);
+	}
+	releaseSend(index);
+}
+
+const char* IoUringReactor::getName() const
+{
+	return "io_uring";
+}
+
+#endif
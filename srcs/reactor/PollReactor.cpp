@@ -0,0 +1,98 @@
+#include "PollReactor.hpp"
+
+PollReactor::PollReactor()
+{
+}
+
+PollReactor::~PollReactor()
+{
+}
+
+static short toPollEvents(int events)
+{
+	short mask = 0;
+	if (events & Reactor::READ)
+		mask |= POLLIN;
+	if (events & Reactor::WRITE)
+		mask |= POLLOUT;
+	return mask;
+}
+
+bool PollReactor::add(int fd, int events)
+{
+	if (fd < 0)
+		return false;
+	if (static_cast<size_t>(fd) >= _slots.size())
+		_slots.resize(fd + 1, -1);
+	if (_slots[fd] >= 0)
+		return modify(fd, events);
+
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = toPollEvents(events);
+	pfd.revents = 0;
+	_slots[fd] = _fds.size();
+	_fds.push_back(pfd);
+	return true;
+}
+
+bool PollReactor::modify(int fd, int events)
+{
+	if (fd < 0 || static_cast<size_t>(fd) >= _slots.size() || _slots[fd] < 0)
+		return false;
+	_fds[_slots[fd]].events = toPollEvents(events);
+	return true;
+}
+
+void PollReactor::remove(int fd)
+{
+	if (fd < 0 || static_cast<size_t>(fd) >= _slots.size() || _slots[fd] < 0)
+		return;
+
+	size_t index = _slots[fd];
+	size_t last = _fds.size() - 1;
+	if (index != last)
+	{
+		_fds[index] = _fds[last];
+		_slots[_fds[index].fd] = index;
+	}
+	_fds.pop_back();
+	_slots[fd] = -1;
+}
+
+int PollReactor::wait(std::vector<Event>& events, int timeoutMs)
+{
+	events.clear();
+	if (_fds.empty())
+		return 0;
+
+	int count = poll(&_fds[0], _fds.size(), timeoutMs);
+	if (count <= 0)
+		return count;
+
+	for (size_t i = 0; i < _fds.size() && static_cast<int>(events.size()) < count; i++)
+	{
+		short revents = _fds[i].revents;
+		if (revents == 0)
+			continue;
+
+		Event event;
+		event.fd = _fds[i].fd;
+		event.events = 0;
+		event.result = 0;
+		event.data = NULL;
+		if (revents & POLLIN)
+			event.events |= READ;
+		if (revents & POLLOUT)
+			event.events |= WRITE;
+		if (revents & (POLLHUP | POLLERR | POLLNVAL))
+			event.events |= HANGUP;
+		events.push_back(event);
+	}
+	return events.size();
+}
+
+const char* PollReactor::getName() const
+{
+	return "poll";
+}
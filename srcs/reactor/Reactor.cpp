@@ -0,0 +1,47 @@
+#include "Reactor.hpp"
+#include "PollReactor.hpp"
+#include "EpollReactor.hpp"
+#include "IoUringReactor.hpp"
+
+Reactor::~Reactor()
+{
+}
+
+bool Reactor::hasCompletions() const
+{
+	return false;
+}
+
+// Readiness backends leave writing to the caller.
+bool Reactor::send(int fd, const struct iovec* iov, size_t count)
+{
+	(void)fd;
+	(void)iov;
+	(void)count;
+	return false;
+}
+
+// Unknown or unavailable backends degrade to the next one down:
+// io_uring -> epoll -> poll.
+Reactor* Reactor::create(const std::string& backend)
+{
+#ifdef __linux__
+	if (backend == "io_uring")
+	{
+		IoUringReactor* reactor = new IoUringReactor();
+		if (reactor->isOpen())
+			return reactor;
+		delete reactor;
+	}
+	if (backend != "poll")
+	{
+		EpollReactor* reactor = new EpollReactor();
+		if (reactor->isOpen())
+			return reactor;
+		delete reactor;
+	}
+#else
+	(void)backend;
+#endif
+	return new PollReactor();
+}
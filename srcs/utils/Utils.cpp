@@ -1,5 +1,53 @@
 #include "Utils.hpp"
 #include <sstream>
+#include <cstring>
+
+std::string Utils::_serverName = "server";
+std::string Utils::_replyPrefix = ":server ";
+
+// "000 " .. "999 ": every numeric rendered once, trailing space included,
+// so a reply copies its code instead of formatting it.
+struct NumericTable
+{
+	char tokens[1000][5];
+
+	NumericTable()
+	{
+		for (int code = 0; code < 1000; ++code)
+		{
+			tokens[code][0] = '0' + code / 100;
+			tokens[code][1] = '0' + code / 10 % 10;
+			tokens[code][2] = '0' + code % 10;
+			tokens[code][3] = ' ';
+			tokens[code][4] = '\0';
+		}
+	}
+};
+
+static const NumericTable kNumerics;
+
+void Utils::setServerName(const std::string& name)
+{
+	_serverName = name;
+	_replyPrefix = ":" + name + " ";
+}
+
+const std::string& Utils::getServerName()
+{
+	return _serverName;
+}
+
+const std::string& Utils::getReplyPrefix()
+{
+	return _replyPrefix;
+}
+
+const char* Utils::numericToken(int code)
+{
+	if (code < 0 || code > 999)
+		code = 0;
+	return kNumerics.tokens[code];
+}
 
 std::string Utils::intToString(int num)
 {
@@ -10,50 +58,67 @@ std::string Utils::intToString(int num)
 
 std::string Utils::formatReply(int code, const std::string& client, const std::string& message)
 {
-	std::string codeStr;
-	if (code < 10)
-		codeStr = "00" + intToString(code);
-	else if (code < 100)
-		codeStr = "0" + intToString(code);
-	else
-		codeStr = intToString(code);
-	
-	return ":server " + codeStr + " " + client + " " + message;
+	std::string reply;
+
+	reply.reserve(_replyPrefix.size() + 4 + client.size() + 1 + message.size());
+	reply.append(_replyPrefix);
+	reply.append(numericToken(code), 4);
+	reply.append(client);
+	reply.append(1, ' ');
+	reply.append(message);
+	return reply;
 }
 
 std::string Utils::formatMessage(const std::string& prefix, const std::string& command, const std::string& params)
 {
 	std::string msg;
+
+	msg.reserve(prefix.size() + command.size() + params.size() + 3);
 	if (!prefix.empty())
-		msg = ":" + prefix + " ";
-	msg += command + " " + params;
+	{
+		msg.append(1, ':');
+		msg.append(prefix);
+		msg.append(1, ' ');
+	}
+	msg.append(command);
+	msg.append(1, ' ');
+	msg.append(params);
+	return msg;
+}
+
+// ":source COMMAND target :text", rendered with one allocation.
+std::string Utils::formatMessage(const std::string& source, const char* command,
+	const std::string& target, const std::string& text)
+{
+	size_t commandLength = std::strlen(command);
+	std::string msg;
+
+	msg.reserve(source.size() + commandLength + target.size() + text.size() + 5);
+	msg.append(1, ':');
+	msg.append(source);
+	msg.append(1, ' ');
+	msg.append(command, commandLength);
+	msg.append(1, ' ');
+	msg.append(target);
+	msg.append(" :", 2);
+	msg.append(text);
 	return msg;
 }
 
-std::vector<std::string> Utils::splitByComma(const std::string& str)
+std::vector<std::string> Utils::splitByComma(const StringView& str)
 {
     std::vector<std::string> result;
-    std::string current;
-    
-    for (size_t i = 0; i < str.length(); ++i)
+    size_t start = 0;
+
+    for (size_t i = 0; i <= str.size(); ++i)
     {
-        if (str[i] == ',')
+        if (i == str.size() || str[i] == ',')
         {
-            if (!current.empty())
-            {
-                result.push_back(current);
-                current.clear();
-            }
-        }
-        else
-        {
-            current += str[i];
+            if (i > start)
+                result.push_back(std::string(str.data() + start, i - start));
+            start = i + 1;
         }
     }
-    
-    if (!current.empty())
-        result.push_back(current);
-    
     return result;
 }
 
@@ -75,4 +140,35 @@ bool Utils::isValidChannelName(const std::string& name)
     }
     
     return true;
+}
+
+// RFC 1459 casemapping: besides ASCII letters, "[]\\~" are the upper-case
+// forms of "{}|^", so "#Foo[1]" and "#foo{1}" name the same channel.
+char Utils::toIrcLower(char c)
+{
+    if (c >= 'A' && c <= 'Z')
+        return c + ('a' - 'A');
+    if (c == '[')
+        return '{';
+    if (c == ']')
+        return '}';
+    if (c == '\\')
+        return '|';
+    if (c == '~')
+        return '^';
+    return c;
+}
+
+bool IrcLess::operator()(const std::string& a, const std::string& b) const
+{
+    size_t length = a.size() < b.size() ? a.size() : b.size();
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        unsigned char left = Utils::toIrcLower(a[i]);
+        unsigned char right = Utils::toIrcLower(b[i]);
+        if (left != right)
+            return left < right;
+    }
+    return a.size() < b.size();
 }
\ No newline at end of file